@@ -0,0 +1,92 @@
+#include "core/memory/memory_allocator.hpp"
+#include "mock_device_memory.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace vrender;
+
+// Churns mixed-size allocations with a bounded live set and reports the state the allocator is left in. Sizes follow
+// a streaming workload: mostly small vertex, index and uniform buffers, some textures and a few large buffers
+
+static constexpr uint32_t OPERATION_COUNT = 100000;
+static constexpr size_t MAX_LIVE_BLOCKS = 8192;
+
+static VkDeviceSize randomSize(std::mt19937& random)
+{
+    std::uniform_int_distribution<uint32_t> kind(0, 99);
+    uint32_t roll = kind(random);
+    if (roll < 70)
+        return std::uniform_int_distribution<VkDeviceSize>(64, 64 * 1024)(random);
+    if (roll < 95)
+        return std::uniform_int_distribution<VkDeviceSize>(64 * 1024, 1024 * 1024)(random);
+    return std::uniform_int_distribution<VkDeviceSize>(1024 * 1024, 8 * 1024 * 1024)(random);
+}
+
+static void run(const char* name, AllocationStrategy strategy)
+{
+    DeviceMemoryAllocator allocator(VK_NULL_HANDLE, mock::memoryProperties(), 1, mock::deviceMemoryFunctions());
+    allocator.setStrategy(0, strategy);
+
+    std::mt19937 random(42);
+    std::vector<MemoryBlock> blocks;
+    blocks.reserve(MAX_LIVE_BLOCKS);
+
+    uint32_t allocations = 0;
+    uint32_t failures = 0;
+    std::chrono::nanoseconds allocateTime(0);
+    for (uint32_t i = 0; i < OPERATION_COUNT; i++)
+    {
+        // Allocate while the live set is small, then free and allocate at random
+        bool allocate = blocks.size() < MAX_LIVE_BLOCKS / 2 ||
+                        (blocks.size() < MAX_LIVE_BLOCKS && std::bernoulli_distribution(0.5)(random));
+        if (!allocate)
+        {
+            size_t index = std::uniform_int_distribution<size_t>(0, blocks.size() - 1)(random);
+            allocator.free(blocks[index]);
+            blocks[index] = blocks.back();
+            blocks.pop_back();
+            continue;
+        }
+
+        VkDeviceSize size = randomSize(random);
+        VkDeviceSize alignment = VkDeviceSize(1) << std::uniform_int_distribution<uint32_t>(4, 12)(random);
+
+        MemoryBlock block;
+        auto start = std::chrono::steady_clock::now();
+        bool allocated = allocator.allocate(size, alignment, 0, block);
+        allocateTime += std::chrono::steady_clock::now() - start;
+
+        allocations++;
+        if (allocated)
+            blocks.push_back(block);
+        else
+            failures++;
+    }
+
+    // Returns the blocks held by the thread cache
+    allocator.update();
+    MemoryTypeStats stats = allocator.stats(0);
+    std::printf("%-9s %10.1f %13.3f %13llu %13llu %13llu %8u %8u\n", name,
+                static_cast<double>(allocateTime.count()) / allocations, stats.fragmentation,
+                static_cast<unsigned long long>(stats.reservedSize >> 10),
+                static_cast<unsigned long long>(stats.allocatedSize >> 10),
+                static_cast<unsigned long long>(stats.wastedSize >> 10), stats.allocationCount, failures);
+
+    for (const MemoryBlock& block : blocks)
+        allocator.free(block);
+}
+
+int main()
+{
+    std::printf("%u operations, at most %zu live blocks\n", OPERATION_COUNT, MAX_LIVE_BLOCKS);
+    std::printf("%-9s %10s %13s %13s %13s %13s %8s %8s\n", "strategy", "ns/alloc", "fragmentation", "reserved KiB",
+                "allocated KiB", "wasted KiB", "memories", "failed");
+
+    run("free list", AllocationStrategy::FreeList);
+    run("tlsf", AllocationStrategy::Tlsf);
+    run("buddy", AllocationStrategy::Buddy);
+    return 0;
+}
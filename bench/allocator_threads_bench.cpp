@@ -0,0 +1,96 @@
+#include "core/memory/memory_allocator.hpp"
+#include "mock_device_memory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace vrender;
+
+// Every thread churns small buffers of a few common sizes on the same memory type, the case the per-type lock
+// serializes and the thread caches are meant to absorb
+
+static constexpr uint32_t OPERATIONS_PER_THREAD = 200000;
+static constexpr size_t LIVE_BLOCKS_PER_THREAD = 64;
+static constexpr VkDeviceSize SIZES[] = {256, 1024, 4096, 16384, 65536};
+
+static void churn(DeviceMemoryAllocator& allocator, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> sizeIndex(0, std::size(SIZES) - 1);
+    std::vector<MemoryBlock> blocks;
+    blocks.reserve(LIVE_BLOCKS_PER_THREAD);
+
+    for (uint32_t i = 0; i < OPERATIONS_PER_THREAD; i++)
+    {
+        if (blocks.size() == LIVE_BLOCKS_PER_THREAD || (!blocks.empty() && random() % 2))
+        {
+            size_t index = random() % blocks.size();
+            allocator.free(blocks[index]);
+            blocks[index] = blocks.back();
+            blocks.pop_back();
+            continue;
+        }
+
+        MemoryBlock block;
+        if (allocator.allocate(SIZES[sizeIndex(random)], 256, 0, block))
+            blocks.push_back(block);
+    }
+
+    for (const MemoryBlock& block : blocks)
+        allocator.free(block);
+}
+
+// Returns the operations per second of all threads together
+static double run(uint32_t threadCount, bool threadCache)
+{
+    DeviceMemoryAllocator allocator(VK_NULL_HANDLE, mock::memoryProperties(), 1, mock::deviceMemoryFunctions());
+    allocator.setThreadCacheEnabled(threadCache);
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < threadCount; i++)
+        threads.emplace_back(churn, std::ref(allocator), i + 1);
+    for (std::thread& thread : threads)
+        thread.join();
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    allocator.update();
+    return threadCount * static_cast<double>(OPERATIONS_PER_THREAD) / duration.count();
+}
+
+// Usage: allocator_threads_bench [max thread count], defaults to the core count
+int main(int argc, char** argv)
+{
+    uint32_t maxThreads = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+    maxThreads = std::max(1u, maxThreads);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t count = 1; count < maxThreads; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(maxThreads);
+
+    std::printf("%u operations per thread, at most %zu live blocks per thread\n", OPERATIONS_PER_THREAD,
+                LIVE_BLOCKS_PER_THREAD);
+    std::printf("%-8s %14s %9s %14s %9s\n", "threads", "cached Mop/s", "scaling", "uncached Mop/s", "scaling");
+
+    double cachedBase = 0.0, uncachedBase = 0.0;
+    for (uint32_t threadCount : threadCounts)
+    {
+        double cached = run(threadCount, true);
+        double uncached = run(threadCount, false);
+        if (threadCount == 1)
+        {
+            cachedBase = cached;
+            uncachedBase = uncached;
+        }
+        std::printf("%-8u %14.2f %8.2fx %14.2f %8.2fx\n", threadCount, cached / 1e6, cached / cachedBase,
+                    uncached / 1e6, uncached / uncachedBase);
+    }
+    return 0;
+}
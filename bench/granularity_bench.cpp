@@ -0,0 +1,73 @@
+#include "core/memory/memory_allocator.hpp"
+#include "mock_device_memory.hpp"
+
+#include <cstdio>
+#include <vector>
+
+using namespace vrender;
+
+// Bytes reserved for small uniform buffers interleaved with images. Page rounding is the previous scheme that
+// padded every request to the next bufferImageGranularity page, separation keeps linear and optimal resources in
+// different allocations and packs buffers at their own alignment
+
+static constexpr uint32_t BUFFER_COUNT = 10000;
+static constexpr VkDeviceSize BUFFER_SIZE = 64;
+static constexpr VkDeviceSize BUFFER_ALIGNMENT = 256; // Typical minUniformBufferOffsetAlignment
+static constexpr uint32_t BUFFERS_PER_IMAGE = 100;
+static constexpr VkDeviceSize IMAGE_SIZE = 256 * 1024;
+
+struct Result
+{
+    VkDeviceSize reservedSize;
+    VkDeviceSize allocatedSize;
+};
+
+static Result run(VkDeviceSize granularity, bool pageRounding)
+{
+    DeviceMemoryAllocator allocator(VK_NULL_HANDLE, mock::memoryProperties(), granularity,
+                                    mock::deviceMemoryFunctions());
+
+    auto allocate = [&](VkDeviceSize size, ResourceTiling tiling, std::vector<MemoryBlock>& blocks) {
+        if (pageRounding)
+            size = ((size / granularity) + 1) * granularity;
+
+        MemoryBlock block;
+        if (allocator.allocate(size, BUFFER_ALIGNMENT, 0, block, pageRounding ? ResourceTiling::Linear : tiling))
+            blocks.push_back(block);
+    };
+
+    std::vector<MemoryBlock> blocks;
+    blocks.reserve(BUFFER_COUNT + BUFFER_COUNT / BUFFERS_PER_IMAGE);
+    for (uint32_t i = 0; i < BUFFER_COUNT; i++)
+    {
+        allocate(BUFFER_SIZE, ResourceTiling::Linear, blocks);
+        if (i % BUFFERS_PER_IMAGE == 0)
+            allocate(IMAGE_SIZE, ResourceTiling::Optimal, blocks);
+    }
+
+    MemoryTypeStats stats = allocator.stats(0);
+    for (const MemoryBlock& block : blocks)
+        allocator.free(block);
+    return {stats.reservedSize, stats.allocatedSize};
+}
+
+int main()
+{
+    std::printf("%u uniform buffers of %llu bytes, one %llu KiB image every %u buffers\n", BUFFER_COUNT,
+                static_cast<unsigned long long>(BUFFER_SIZE), static_cast<unsigned long long>(IMAGE_SIZE >> 10),
+                BUFFERS_PER_IMAGE);
+    std::printf("%-12s %-14s %14s %15s\n", "granularity", "scheme", "reserved KiB", "allocated KiB");
+
+    for (VkDeviceSize granularity : {VkDeviceSize(1), VkDeviceSize(1024), VkDeviceSize(4096), VkDeviceSize(65536)})
+    {
+        for (bool pageRounding : {true, false})
+        {
+            Result result = run(granularity, pageRounding);
+            std::printf("%-12llu %-14s %14llu %15llu\n", static_cast<unsigned long long>(granularity),
+                        pageRounding ? "page rounding" : "separation",
+                        static_cast<unsigned long long>(result.reservedSize >> 10),
+                        static_cast<unsigned long long>(result.allocatedSize >> 10));
+        }
+    }
+    return 0;
+}
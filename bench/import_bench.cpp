@@ -0,0 +1,100 @@
+#include "scene/model/mesh.hpp"
+#include "utils/thread_pool.hpp"
+
+#include "assimp/Importer.hpp"
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vrender;
+
+// Mesh import wall time over every model in a directory against the number of threads. Import is the whole
+// Mesh::loadFromFile, parsing included, convert only the parallel conversion of an already parsed scene
+
+static constexpr uint32_t REPETITIONS = 5;
+
+// Best of a few runs, in milliseconds
+static double measure(const std::function<void()>& function)
+{
+    double best = 0.0;
+    for (uint32_t i = 0; i < REPETITIONS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        double duration =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = i == 0 ? duration : std::min(best, duration);
+    }
+    return best;
+}
+
+// Usage: import_bench [model directory], defaults to ../assets/models
+int main(int argc, char** argv)
+{
+    std::string directory = argc > 1 ? argv[1] : "../assets/models";
+
+    Assimp::Importer importer;
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.is_regular_file() && importer.IsExtensionSupported(entry.path().extension().string()))
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+    {
+        std::printf("No models found in %s\n", directory.c_str());
+        return 1;
+    }
+
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t count = 1; count < maxThreads; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(maxThreads);
+
+    for (const std::string& file : files)
+    {
+        const aiScene* scene =
+            importer.ReadFile(file, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
+        if (!scene)
+        {
+            std::printf("%s: %s\n", file.c_str(), importer.GetErrorString());
+            continue;
+        }
+
+        std::printf("%s (%u meshes)\n", file.c_str(), scene->mNumMeshes);
+        std::printf("  %-8s %11s %9s %12s %9s\n", "threads", "import ms", "speedup", "convert ms", "speedup");
+
+        double importBase = 0.0, convertBase = 0.0;
+        for (uint32_t threadCount : threadCounts)
+        {
+            // parallelFor runs on the calling thread as well, so one worker less gives threadCount threads
+            std::unique_ptr<ThreadPool> threadPool;
+            if (threadCount > 1)
+                threadPool = std::make_unique<ThreadPool>(threadCount - 1);
+
+            double importTime = measure([&]() { Mesh::loadFromFile(file, threadPool.get()); });
+            double convertTime = measure([&]() { Mesh::convertScene(scene, threadPool.get()); });
+            if (threadCount == 1)
+            {
+                importBase = importTime;
+                convertBase = convertTime;
+            }
+            std::printf("  %-8u %11.2f %8.2fx %12.2f %8.2fx\n", threadCount, importTime, importBase / importTime,
+                        convertTime, convertBase / convertTime);
+        }
+        importer.FreeScene();
+    }
+    return 0;
+}
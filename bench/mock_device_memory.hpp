@@ -0,0 +1,87 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace vrender
+{
+
+// Device memory backed by host memory, so DeviceMemoryAllocator runs without a GPU. Pages of device local memory are
+// never touched, only the address space is reserved
+namespace mock
+{
+
+inline std::atomic<uint64_t> deviceMemoryCount = 0;
+
+inline VKAPI_ATTR VkResult VKAPI_CALL allocateMemory(VkDevice, const VkMemoryAllocateInfo* allocateInfo,
+                                                     const VkAllocationCallbacks*, VkDeviceMemory* memory)
+{
+    void* data = std::malloc(allocateInfo->allocationSize);
+    if (!data)
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    *memory = reinterpret_cast<VkDeviceMemory>(data);
+    deviceMemoryCount++;
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL freeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+    if (!memory)
+        return;
+
+    std::free(reinterpret_cast<void*>(memory));
+    deviceMemoryCount--;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL mapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize,
+                                                VkMemoryMapFlags, void** data)
+{
+    *data = reinterpret_cast<uint8_t*>(memory) + offset;
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL unmapMemory(VkDevice, VkDeviceMemory)
+{
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL flushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+    return VK_SUCCESS;
+}
+
+inline DeviceMemoryFunctions deviceMemoryFunctions()
+{
+    DeviceMemoryFunctions functions;
+    functions.allocateMemory = allocateMemory;
+    functions.freeMemory = freeMemory;
+    functions.mapMemory = mapMemory;
+    functions.unmapMemory = unmapMemory;
+    functions.flushMappedMemoryRanges = flushMappedMemoryRanges;
+    functions.invalidateMappedMemoryRanges = flushMappedMemoryRanges;
+    return functions;
+}
+
+// Memory type 0 is device local, type 1 host visible and coherent
+inline VkPhysicalDeviceMemoryProperties memoryProperties(VkDeviceSize deviceLocalSize = 16ull << 30)
+{
+    VkPhysicalDeviceMemoryProperties properties = {};
+    properties.memoryHeapCount = 2;
+    properties.memoryHeaps[0].size = deviceLocalSize;
+    properties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    properties.memoryHeaps[1].size = 4ull << 30;
+
+    properties.memoryTypeCount = 2;
+    properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[0].heapIndex = 0;
+    properties.memoryTypes[1].propertyFlags =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    properties.memoryTypes[1].heapIndex = 1;
+    return properties;
+}
+
+} // namespace mock
+
+}; // namespace vrender
@@ -3,6 +3,7 @@
 #include "core/engine.hpp"
 #include "core/rendering/render_system.hpp"
 #include "scene/model/mesh.hpp"
+#include "scene/model/model.hpp"
 
 namespace vrender
 {
@@ -19,18 +20,31 @@ void VRender::init()
                                                       EventType::InputState});
     Entity* entity = world()->createEntity();
 
-    entity->addComponent<Mesh>("../assets/models/stool.obj");
+    // Loads in the background, the entity is drawn once the mesh is resident and white until the texture is ready
+    AssetManager* assetManager = GraphicsContext::get().assetManager();
+    auto material = std::make_shared<Material>();
+    material->name = "Stool";
+    material->baseColorTexture = assetManager->loadTexture("../assets/models/Stool_Albedo.png");
+    entity->addComponent<MeshInstance>(assetManager->loadMesh("../assets/models/stool.obj"), material);
     entity->addComponent<Transform>();
 
     entity->getComponent<Transform>()->position = glm::vec3(0.0f, 0.0f, 0.0f);
     entity->getComponent<Transform>()->scale = glm::vec3(1.1f);
 
-    world()->addSystem<MeshRenderSystem>();
+    // Imported in the background, instantiated by update once its geometry is resident
+    m_Model = assetManager->loadModel("../assets/models/scene.gltf");
 
-    Texture texture("../assets/models/Stool_Albedo.png");
+    world()->addSystem<MeshRenderSystem>();
 }
 
 void VRender::update(double deltaTime) {
+    // One entity per node, all nodes draw from the geometry of the model
+    if (!m_ModelInstantiated && m_Model->ready())
+    {
+        m_Model->get()->instantiate(world());
+        m_ModelInstantiated = true;
+    }
+
     for (auto e : world()->entities())
     {
         if (e->hasComponent<Transform>()) {
@@ -3,6 +3,7 @@
 #include "app/app.hpp"
 
 #include "events/key_events.hpp"
+#include "scene/model/model.hpp"
 #include "utils/log.hpp"
 #include "utils/noncopyable.hpp"
 
@@ -20,6 +21,9 @@ public:
     virtual void terminate() override;
 
 private:
+    AssetHandle<Model> m_Model; // Keeps the material textures loaded
+    bool m_ModelInstantiated = false;
+
     inline static const AppInfo sAppInfo = {"VRender", 1, 2};
 };
 }; // namespace vrender
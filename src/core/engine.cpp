@@ -44,7 +44,7 @@ int Engine::run()
         m_App->update(deltaTime);
     }
     glfwTerminate();
-    vkDeviceWaitIdle(device()->device());
+    device()->waitIdle();
     return 0;
 }
 
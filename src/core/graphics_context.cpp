@@ -5,9 +5,19 @@ namespace vrender
 {
 void GraphicsContext::init(const AppInfo& appInfo)
 {
+    m_ThreadPool = std::make_unique<ThreadPool>();
     m_Window = std::make_unique<Window>(appInfo.title);
     m_Device = std::make_unique<Device>(appInfo, m_Window.get());
     m_MemoryAllocator = std::make_unique<DeviceMemoryAllocator>(device(), device()->memorySize());
+    m_FrameAllocator = std::make_unique<FrameAllocator>(device(), m_MemoryAllocator.get(), FRAME_ALLOCATOR_SIZE,
+                                                        SwapChain::MAX_FRAMES_IN_FLIGHT);
+    m_Defragmenter =
+        std::make_unique<Defragmenter>(device(), m_MemoryAllocator.get(), SwapChain::MAX_FRAMES_IN_FLIGHT);
+    m_UploadManager = std::make_unique<UploadManager>(device(), m_MemoryAllocator.get(), UPLOAD_STAGING_SIZE);
+    m_GeometryPool = std::make_unique<GeometryPool>(device(), m_MemoryAllocator.get(), m_UploadManager.get(),
+                                                    m_Defragmenter.get(), SwapChain::MAX_FRAMES_IN_FLIGHT);
+    m_AssetManager = std::make_unique<AssetManager>(m_ThreadPool.get(), m_UploadManager.get(), m_MemoryAllocator.get(),
+                                                    SwapChain::MAX_FRAMES_IN_FLIGHT);
     m_SwapChain = std::make_unique<SwapChain>(m_Device.get(), m_Window.get());
     m_World = std::make_unique<Scene>();
     m_Renderer = std::make_unique<Renderer>(m_Device.get(), m_SwapChain.get(), m_Window.get());
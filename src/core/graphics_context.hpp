@@ -1,11 +1,17 @@
 #pragma once
 
 #include "app/window.hpp"
+#include "core/memory/defragmenter.hpp"
+#include "core/memory/frame_allocator.hpp"
+#include "core/memory/geometry_pool.hpp"
 #include "core/memory/memory_allocator.hpp"
+#include "core/memory/upload_manager.hpp"
 #include "core/rendering/renderer.hpp"
 #include "core/vulkan/device.hpp"
 #include "core/vulkan/swap_chain.hpp"
+#include "scene/asset_manager.hpp"
 #include "utils/noncopyable.hpp"
+#include "utils/thread_pool.hpp"
 
 #include <memory>
 
@@ -29,7 +35,14 @@ public:
     inline Window* window() const { return m_Window.get(); }
     inline SwapChain* swapChain() const { return m_SwapChain.get(); }
     inline DeviceMemoryAllocator* deviceMemoryAllocator() const { return m_MemoryAllocator.get(); }
+    inline FrameAllocator* frameAllocator() const { return m_FrameAllocator.get(); }
+    inline Defragmenter* defragmenter() const { return m_Defragmenter.get(); }
+    inline UploadManager* uploadManager() const { return m_UploadManager.get(); }
+    inline GeometryPool* geometryPool() const { return m_GeometryPool.get(); }
+    inline AssetManager* assetManager() const { return m_AssetManager.get(); }
     inline Scene* world() const { return m_World.get(); }
+    // Workers for CPU side asset processing
+    inline ThreadPool* threadPool() const { return m_ThreadPool.get(); }
 
 protected:
     static bool create();
@@ -38,11 +51,20 @@ private:
     GraphicsContext() {}
     static GraphicsContext* m_Context;
 
+    static constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 8 * 1024 * 1024; // Per frame in flight
+    static constexpr VkDeviceSize UPLOAD_STAGING_SIZE = 32 * 1024 * 1024;
+
     std::unique_ptr<Window> m_Window;
     std::unique_ptr<Device> m_Device;
     std::unique_ptr<SwapChain> m_SwapChain;
     std::unique_ptr<DeviceMemoryAllocator> m_MemoryAllocator;
+    std::unique_ptr<FrameAllocator> m_FrameAllocator;
+    std::unique_ptr<Defragmenter> m_Defragmenter;
+    std::unique_ptr<UploadManager> m_UploadManager;
+    std::unique_ptr<GeometryPool> m_GeometryPool;
+    std::unique_ptr<AssetManager> m_AssetManager;
     std::unique_ptr<Renderer> m_Renderer;
     std::unique_ptr<Scene> m_World;
+    std::unique_ptr<ThreadPool> m_ThreadPool; // Last so it is joined before anything its tasks may use is destroyed
 };
 }; // namespace vrender
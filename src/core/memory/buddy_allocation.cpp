@@ -0,0 +1,121 @@
+#include "buddy_allocation.hpp"
+
+#include <algorithm>
+
+namespace vrender
+{
+
+BuddyAllocation::BuddyAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                                 uint32_t memoryTypeIndex)
+    : MemoryAllocation(device, functions, size, memoryTypeIndex)
+{
+    if (!valid() || size < MIN_BLOCK_SIZE)
+        return;
+
+    while (blockSize(m_MaxOrder + 1) <= size)
+        m_MaxOrder++;
+
+    m_FreeBlocks.resize(m_MaxOrder + 1);
+    m_FreeBlocks[m_MaxOrder].insert(0);
+}
+
+bool BuddyAllocation::allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block)
+{
+    if (m_FreeBlocks.empty() || size == 0)
+        return false;
+
+    // Blocks are aligned to their own size
+    VkDeviceSize required = std::max(size, alignment);
+    uint32_t order = 0;
+    while (blockSize(order) < required)
+    {
+        if (++order > m_MaxOrder)
+            return false;
+    }
+
+    uint32_t freeOrder = order;
+    while (freeOrder <= m_MaxOrder && m_FreeBlocks[freeOrder].empty())
+        freeOrder++;
+    if (freeOrder > m_MaxOrder)
+        return false;
+
+    VkDeviceSize offset = *m_FreeBlocks[freeOrder].begin();
+    m_FreeBlocks[freeOrder].erase(m_FreeBlocks[freeOrder].begin());
+
+    // Split down to the requested order, keeping the lower half each time
+    while (freeOrder > order)
+    {
+        freeOrder--;
+        m_FreeBlocks[freeOrder].insert(offset + blockSize(freeOrder));
+    }
+
+    m_UsedBlocks[offset] = {order, size};
+    m_AllocatedSize += blockSize(order);
+    m_WastedSize += blockSize(order) - size;
+
+    block = createBlock(offset, size, 0, false);
+    return true;
+}
+
+bool BuddyAllocation::freeBlock(const MemoryBlock& block)
+{
+    auto it = m_UsedBlocks.find(block.offset);
+    if (it == m_UsedBlocks.end())
+        return false;
+
+    VkDeviceSize offset = it->first;
+    uint32_t order = it->second.order;
+    m_AllocatedSize -= blockSize(order);
+    m_WastedSize -= blockSize(order) - it->second.requestedSize;
+    m_UsedBlocks.erase(it);
+
+    while (order < m_MaxOrder)
+    {
+        VkDeviceSize buddy = offset ^ blockSize(order);
+        auto buddyIt = m_FreeBlocks[order].find(buddy);
+        if (buddyIt == m_FreeBlocks[order].end())
+            break;
+
+        m_FreeBlocks[order].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+
+    m_FreeBlocks[order].insert(offset);
+    return true;
+}
+
+VkDeviceSize BuddyAllocation::largestFreeRange() const
+{
+    for (uint32_t order = static_cast<uint32_t>(m_FreeBlocks.size()); order > 0; order--)
+    {
+        if (!m_FreeBlocks[order - 1].empty())
+            return blockSize(order - 1);
+    }
+    return 0;
+}
+
+void BuddyAllocation::ranges(std::vector<MemoryBlock>& ranges) const
+{
+    size_t first = ranges.size();
+    for (uint32_t order = 0; order < m_FreeBlocks.size(); order++)
+    {
+        for (VkDeviceSize offset : m_FreeBlocks[order])
+            ranges.push_back(createBlock(offset, blockSize(order), 0, true));
+    }
+    for (const auto& [offset, used] : m_UsedBlocks)
+        ranges.push_back(createBlock(offset, blockSize(used.order), 0, false));
+
+    std::sort(ranges.begin() + first, ranges.end(),
+              [](const MemoryBlock& a, const MemoryBlock& b) { return a.offset < b.offset; });
+}
+
+size_t BuddyAllocation::freeRangeCount() const
+{
+    size_t count = 0;
+    for (const std::set<VkDeviceSize>& freeBlocks : m_FreeBlocks)
+        count += freeBlocks.size();
+    return count;
+}
+
+}; // namespace vrender
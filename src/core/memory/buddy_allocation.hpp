@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace vrender
+{
+
+// Power of two sized blocks split in halves on allocation and merged with their buddy on free,
+// both O(log n). Meant for resources that already come in power of two sizes, anything else is
+// rounded up and the difference is reported as wasted.
+class BuddyAllocation : public MemoryAllocation
+{
+public:
+    // Size is expected to be a power of two
+    BuddyAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                    uint32_t memoryTypeIndex);
+
+    virtual bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block) override;
+    virtual bool freeBlock(const MemoryBlock& block) override;
+
+    virtual VkDeviceSize largestFreeRange() const override;
+    virtual size_t freeRangeCount() const override;
+    virtual void ranges(std::vector<MemoryBlock>& ranges) const override;
+
+    static constexpr VkDeviceSize MIN_BLOCK_SIZE = 256;
+
+private:
+    struct UsedBlock
+    {
+        uint32_t order;
+        VkDeviceSize requestedSize;
+    };
+
+    inline VkDeviceSize blockSize(uint32_t order) const { return MIN_BLOCK_SIZE << order; }
+
+    uint32_t m_MaxOrder = 0;
+
+    // Free block offsets per order, lowest address first
+    std::vector<std::set<VkDeviceSize>> m_FreeBlocks;
+    std::unordered_map<VkDeviceSize, UsedBlock> m_UsedBlocks;
+};
+
+}; // namespace vrender
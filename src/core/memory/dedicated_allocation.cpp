@@ -0,0 +1,39 @@
+#include "dedicated_allocation.hpp"
+
+namespace vrender
+{
+
+DedicatedAllocation::DedicatedAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                                         uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image)
+    : MemoryAllocation(device, functions, size, memoryTypeIndex, buffer, image)
+{
+}
+
+bool DedicatedAllocation::allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block)
+{
+    if (!valid() || m_AllocatedSize || size > m_Size)
+        return false;
+
+    m_AllocatedSize = m_Size;
+    m_WastedSize = m_Size - size;
+    block = createBlock(0, size, 0, false);
+    return true;
+}
+
+bool DedicatedAllocation::freeBlock(const MemoryBlock& block)
+{
+    if (!m_AllocatedSize || block.offset != 0)
+        return false;
+
+    m_AllocatedSize = 0;
+    m_WastedSize = 0;
+    return true;
+}
+
+void DedicatedAllocation::ranges(std::vector<MemoryBlock>& ranges) const
+{
+    if (valid())
+        ranges.push_back(createBlock(0, m_Size, 0, m_AllocatedSize == 0));
+}
+
+}; // namespace vrender
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+
+namespace vrender
+{
+
+// Device memory owned by a single resource, released as soon as the block is freed
+class DedicatedAllocation : public MemoryAllocation
+{
+public:
+    // Buffer or image may be given to let the driver optimize for the resource (VK_KHR_dedicated_allocation)
+    DedicatedAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                        uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image);
+
+    virtual bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block) override;
+    virtual bool freeBlock(const MemoryBlock& block) override;
+
+    virtual VkDeviceSize largestFreeRange() const override { return m_AllocatedSize ? 0 : m_Size; }
+    virtual size_t freeRangeCount() const override { return m_AllocatedSize ? 0 : 1; }
+    virtual void ranges(std::vector<MemoryBlock>& ranges) const override;
+
+    virtual bool dedicated() const override { return true; }
+};
+
+}; // namespace vrender
@@ -0,0 +1,288 @@
+#include "defragmenter.hpp"
+#include "utils/log.hpp"
+
+namespace vrender
+{
+
+Defragmenter::Defragmenter(Device* device, DeviceMemoryAllocator* allocator, uint32_t frameCount,
+                           VkDeviceSize bytesPerFrame)
+    : m_Device(device), m_Allocator(allocator), m_FrameCount(frameCount), m_BytesPerFrame(bytesPerFrame)
+{
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    allocInfo.commandPool = m_Device->commandPool();
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkAllocateCommandBuffers(m_Device->device(), &allocInfo, &m_CommandBuffer) != VK_SUCCESS ||
+        vkCreateFence(m_Device->device(), &fenceInfo, nullptr, &m_Fence) != VK_SUCCESS)
+    {
+        V_LOG_ERROR("Unable to create defragmenter command buffer.");
+        m_Enabled = false;
+    }
+}
+
+Defragmenter::~Defragmenter()
+{
+    if (m_Submitted)
+    {
+        vkWaitForFences(m_Device->device(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+        completeMoves();
+    }
+
+    for (const Retired& retired : m_Retired)
+        destroy(retired.buffer, retired.memory);
+
+    vkDestroyFence(m_Device->device(), m_Fence, nullptr);
+    if (m_CommandBuffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(m_Device->device(), m_Device->commandPool(), 1, &m_CommandBuffer);
+}
+
+void Defragmenter::registerBuffer(VkBuffer* buffer, MemoryBlock* memory, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Resources[buffer] = {buffer, memory, size, usage};
+}
+
+void Defragmenter::unregisterBuffer(VkBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Submitted)
+    {
+        for (const Move& move : m_Moves)
+        {
+            if (move.owner != buffer)
+                continue;
+
+            // Let the move finish, the owner then destroys the new buffer and the old one is retired
+            vkWaitForFences(m_Device->device(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+            completeMoves();
+            break;
+        }
+    }
+
+    m_Resources.erase(buffer);
+}
+
+void Defragmenter::update()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (auto it = m_Retired.begin(); it != m_Retired.end();)
+    {
+        if (--it->frames == 0)
+        {
+            destroy(it->buffer, it->memory);
+            it = m_Retired.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    if (m_Submitted)
+    {
+        if (vkGetFenceStatus(m_Device->device(), m_Fence) != VK_SUCCESS)
+            return;
+        completeMoves();
+    }
+
+    // The allocator releases allocations that stay empty on its own
+    if (m_Source && !m_Allocator->contains(m_Source))
+        m_Source = nullptr;
+
+    // Fails as long as blocks are left in the source
+    if (m_Source && m_Allocator->releaseAllocation(m_Source))
+        m_Source = nullptr;
+
+    if (!m_Enabled)
+        return;
+
+    if (m_IdleFrames > 0)
+    {
+        m_IdleFrames--;
+        return;
+    }
+
+    if (!m_Source)
+        m_Source = findSource();
+
+    if (!m_Source || !recordMoves())
+    {
+        m_Source = nullptr;
+        m_IdleFrames = RETRY_FRAMES;
+    }
+}
+
+MemoryAllocation* Defragmenter::findSource() const
+{
+    MemoryAllocation* source = nullptr;
+    float lowestOccupancy = MAX_SOURCE_OCCUPANCY;
+
+    for (uint32_t type = 0; type < m_Allocator->memoryTypeCount(); type++)
+    {
+        std::lock_guard<std::mutex> lock(m_Allocator->mutex(type));
+        MemoryAllocation* head = m_Allocator->allocations(type);
+        if (!head || !head->next())
+            continue;
+
+        VkDeviceSize remainingSize = 0;
+        for (MemoryAllocation* allocation = head; allocation; allocation = allocation->next())
+            remainingSize += allocation->remainingSize();
+
+        for (MemoryAllocation* allocation = head; allocation; allocation = allocation->next())
+        {
+            // Requested bytes of all blocks, padding and rounding are counted as waste
+            VkDeviceSize liveSize = allocation->allocatedSize() - allocation->wastedSize();
+            float occupancy = static_cast<float>(allocation->allocatedSize()) / allocation->size();
+            if (liveSize == 0 || occupancy >= lowestOccupancy)
+                continue;
+            if (remainingSize - allocation->remainingSize() < allocation->allocatedSize())
+                continue;
+
+            // Blocks owned by anything not registered would keep the allocation alive
+            VkDeviceSize registeredSize = 0;
+            for (const auto& [key, resource] : m_Resources)
+            {
+                if (resource.memory->allocation == allocation)
+                    registeredSize += resource.memory->size;
+            }
+            if (registeredSize != liveSize)
+                continue;
+
+            source = allocation;
+            lowestOccupancy = occupancy;
+        }
+    }
+    return source;
+}
+
+bool Defragmenter::recordMoves()
+{
+    VkDeviceSize movedSize = 0;
+    bool failed = false;
+
+    for (const auto& [key, resource] : m_Resources)
+    {
+        if (resource.memory->allocation != m_Source)
+            continue;
+        // Buffers larger than the budget are moved alone, otherwise no frame could ever move them
+        if (movedSize > 0 && movedSize + resource.size > m_BytesPerFrame)
+            continue;
+
+        VkBufferCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        createInfo.size = resource.size;
+        createInfo.usage = resource.usage;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        Move move = {};
+        move.owner = resource.buffer;
+        if (vkCreateBuffer(m_Device->device(), &createInfo, nullptr, &move.buffer) != VK_SUCCESS)
+        {
+            failed = true;
+            break;
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(m_Device->device(), move.buffer, &requirements);
+        if (!m_Allocator->allocateExcluding(requirements.size, requirements.alignment, resource.memory->typeIndex,
+                                            m_Source, move.memory))
+        {
+            vkDestroyBuffer(m_Device->device(), move.buffer, nullptr);
+            failed = true;
+            break;
+        }
+        vkBindBufferMemory(m_Device->device(), move.buffer, move.memory.memory, move.memory.offset);
+
+        if (m_Moves.empty())
+        {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(m_CommandBuffer, &beginInfo);
+        }
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.size = resource.size;
+        vkCmdCopyBuffer(m_CommandBuffer, *resource.buffer, move.buffer, 1, &copyRegion);
+
+        m_Moves.push_back(move);
+        movedSize += resource.size;
+    }
+
+    if (m_Moves.empty())
+    {
+        // Nothing left to move, the allocation is only waiting on retired blocks unless something else
+        // that cannot be moved was allocated into it meanwhile
+        if (failed)
+            return false;
+        for (const Retired& retired : m_Retired)
+        {
+            if (retired.memory.allocation == m_Source)
+                return true;
+        }
+        return false;
+    }
+
+    // Make the copies visible to any later use of the moved buffers
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(m_CommandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffer;
+
+    vkResetFences(m_Device->device(), 1, &m_Fence);
+    if (m_Device->submit(m_Device->graphicsQueue(), 1, &submitInfo, m_Fence) != VK_SUCCESS)
+    {
+        V_LOG_ERROR("Unable to submit defragmentation copies.");
+        for (const Move& move : m_Moves)
+            destroy(move.buffer, move.memory);
+        m_Moves.clear();
+        return false;
+    }
+
+    m_Submitted = true;
+    return !failed;
+}
+
+void Defragmenter::completeMoves()
+{
+    for (const Move& move : m_Moves)
+    {
+        auto it = m_Resources.find(move.owner);
+        if (it == m_Resources.end())
+        {
+            destroy(move.buffer, move.memory);
+            continue;
+        }
+
+        // Frames recorded before the switch may still read the old buffer
+        Resource& resource = it->second;
+        m_Retired.push_back({*resource.buffer, *resource.memory, m_FrameCount});
+        *resource.buffer = move.buffer;
+        *resource.memory = move.memory;
+    }
+
+    m_Moves.clear();
+    m_Submitted = false;
+}
+
+void Defragmenter::destroy(VkBuffer buffer, const MemoryBlock& memory)
+{
+    vkDestroyBuffer(m_Device->device(), buffer, nullptr);
+    m_Allocator->free(memory);
+}
+
+}; // namespace vrender
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+#include "core/vulkan/device.hpp"
+#include "utils/noncopyable.hpp"
+
+#include "vulkan/vulkan.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace vrender
+{
+
+// Incrementally moves buffers out of sparsely used device memory so it can be released. Each frame a
+// limited number of bytes is copied on the GPU, once a copy has completed the owner's buffer handle and
+// memory block are replaced and the old ones destroyed after the frames in flight that used them.
+// Buffers may be registered from any thread, update belongs to the render thread.
+class Defragmenter : private NonCopyable
+{
+public:
+    Defragmenter(Device* device, DeviceMemoryAllocator* allocator, uint32_t frameCount,
+                 VkDeviceSize bytesPerFrame = DEFAULT_BYTES_PER_FRAME);
+    ~Defragmenter();
+
+    // buffer and memory are updated in place when the buffer is moved. Its contents must not be written
+    // after creation and usage must include both transfer source and destination
+    void registerBuffer(VkBuffer* buffer, MemoryBlock* memory, VkDeviceSize size, VkBufferUsageFlags usage);
+    // Waits for a copy of the buffer in flight, must be called before the buffer is destroyed
+    void unregisterBuffer(VkBuffer* buffer);
+
+    void setBytesPerFrame(VkDeviceSize bytesPerFrame) { m_BytesPerFrame = bytesPerFrame; }
+    void setEnabled(bool enabled) { m_Enabled = enabled; }
+
+    // Must be called once per frame after the fence of the frame has been waited on
+    void update();
+
+private:
+    struct Resource
+    {
+        VkBuffer* buffer;
+        MemoryBlock* memory;
+        VkDeviceSize size;
+        VkBufferUsageFlags usage;
+    };
+
+    struct Move
+    {
+        VkBuffer* owner;
+        VkBuffer buffer;
+        MemoryBlock memory;
+    };
+
+    struct Retired
+    {
+        VkBuffer buffer;
+        MemoryBlock memory;
+        uint32_t frames; // Frames left until no submitted frame can use the buffer
+    };
+
+    // Allocation of a type with more than one allocation that is least occupied and only holds registered buffers
+    MemoryAllocation* findSource() const;
+    bool recordMoves();
+    void completeMoves();
+    void destroy(VkBuffer buffer, const MemoryBlock& memory);
+
+    Device* m_Device;
+    DeviceMemoryAllocator* m_Allocator;
+
+    std::mutex m_Mutex; // Held by update and registration, guards everything below
+    std::unordered_map<VkBuffer*, Resource> m_Resources;
+    std::vector<Move> m_Moves;
+    std::vector<Retired> m_Retired;
+
+    MemoryAllocation* m_Source = nullptr;
+
+    VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+    VkFence m_Fence = VK_NULL_HANDLE;
+    bool m_Submitted = false;
+    bool m_Enabled = true;
+
+    uint32_t m_FrameCount;
+    uint32_t m_IdleFrames = 0;
+    VkDeviceSize m_BytesPerFrame;
+
+    static constexpr VkDeviceSize DEFAULT_BYTES_PER_FRAME = 4 * 1024 * 1024;
+    // Allocations more occupied than this are not worth moving
+    static constexpr float MAX_SOURCE_OCCUPANCY = 0.5f;
+    // Frames to wait before looking for a new source after one could not be emptied
+    static constexpr uint32_t RETRY_FRAMES = 120;
+};
+
+}; // namespace vrender
@@ -0,0 +1,77 @@
+#include "frame_allocator.hpp"
+#include "utils/log.hpp"
+
+namespace vrender
+{
+
+FrameAllocator::FrameAllocator(Device* device, DeviceMemoryAllocator* allocator, VkDeviceSize frameSize,
+                               uint32_t frameCount)
+    : m_Device(device), m_Allocator(allocator), m_FrameSize(frameSize), m_FrameCount(frameCount)
+{
+    if (!createBuffer())
+    {
+        V_LOG_ERROR("Unable to create frame allocator buffer.");
+        m_FrameSize = 0;
+        m_Data = nullptr;
+    }
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    vkDestroyBuffer(m_Device->device(), m_Buffer, nullptr);
+    if (m_Memory.allocation)
+        m_Allocator->free(m_Memory);
+}
+
+bool FrameAllocator::createBuffer()
+{
+    VkBufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = m_FrameSize * m_FrameCount;
+    createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_Device->device(), &createInfo, nullptr, &m_Buffer) != VK_SUCCESS)
+        return false;
+
+    // Host visible allocations stay mapped, writes are plain memcpys into the block
+    if (!m_Allocator->allocateForBuffer(m_Buffer,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        m_Memory))
+        return false;
+
+    vkBindBufferMemory(m_Device->device(), m_Buffer, m_Memory.memory, m_Memory.offset);
+    m_Data = static_cast<uint8_t*>(m_Memory.mapped);
+
+    return m_Data != nullptr;
+}
+
+void FrameAllocator::beginFrame(uint32_t frame)
+{
+    m_CurrentFrame = frame % m_FrameCount;
+    m_Offset = 0;
+}
+
+bool FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, FrameAllocation& allocation)
+{
+    if (!m_Data)
+        return false;
+    if (alignment == 0)
+        alignment = 1;
+
+    VkDeviceSize regionStart = m_CurrentFrame * m_FrameSize;
+    VkDeviceSize offset = ((regionStart + m_Offset + alignment - 1) / alignment) * alignment - regionStart;
+    if (offset + size > m_FrameSize)
+        return false;
+
+    allocation.buffer = m_Buffer;
+    allocation.offset = regionStart + offset;
+    allocation.size = size;
+    allocation.data = m_Data + allocation.offset;
+
+    m_Offset = offset + size;
+    return true;
+}
+
+}; // namespace vrender
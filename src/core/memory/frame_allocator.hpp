@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+#include "core/vulkan/device.hpp"
+#include "utils/noncopyable.hpp"
+
+#include "vulkan/vulkan.h"
+
+namespace vrender
+{
+
+struct FrameAllocation
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* data;
+};
+
+// Linear allocator for data that only lives for one frame. Each frame in flight owns a region
+// of one persistently mapped host visible buffer, allocating is a pointer bump and the whole
+// region is reclaimed once the fence of that frame has signaled.
+class FrameAllocator : private NonCopyable
+{
+public:
+    FrameAllocator(Device* device, DeviceMemoryAllocator* allocator, VkDeviceSize frameSize, uint32_t frameCount);
+    ~FrameAllocator();
+
+    // Must only be called once the fence of the frame has signaled
+    void beginFrame(uint32_t frame);
+
+    // Returns false if the request does not fit in what is left of the current frame region
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, FrameAllocation& allocation);
+
+    inline VkBuffer buffer() const { return m_Buffer; }
+    inline VkDeviceSize frameSize() const { return m_FrameSize; }
+    inline VkDeviceSize usedSize() const { return m_Offset; }
+
+private:
+    bool createBuffer();
+
+    Device* m_Device;
+    DeviceMemoryAllocator* m_Allocator;
+
+    VkBuffer m_Buffer = VK_NULL_HANDLE;
+    MemoryBlock m_Memory = {};
+    uint8_t* m_Data = nullptr;
+
+    VkDeviceSize m_FrameSize;
+    uint32_t m_FrameCount;
+    uint32_t m_CurrentFrame = 0;
+    VkDeviceSize m_Offset = 0;
+};
+
+}; // namespace vrender
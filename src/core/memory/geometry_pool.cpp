@@ -0,0 +1,295 @@
+#include "geometry_pool.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+namespace vrender
+{
+
+GeometryPool::GeometryPool(Device* device, DeviceMemoryAllocator* allocator, UploadManager* uploadManager,
+                           Defragmenter* defragmenter, uint32_t frameCount, uint32_t chunkVertexCount,
+                           uint32_t chunkIndexCount)
+    : m_Device(device), m_Allocator(allocator), m_UploadManager(uploadManager), m_Defragmenter(defragmenter),
+      m_FrameCount(frameCount), m_ChunkVertexCount(chunkVertexCount), m_ChunkIndexCount(chunkIndexCount)
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+    m_UploadManager->wait(m_UploadTicket);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (uint32_t i = 0; i < m_Chunks.size(); i++)
+        destroyChunk(i);
+}
+
+bool GeometryPool::allocate(const VertexLayout& layout, const void* vertexData, uint32_t vertexCount,
+                            const uint32_t* indices, uint32_t indexCount, GeometryHandle& handle)
+{
+    // The handle stays empty on failure, so freeing it is a no-op
+    handle = {};
+    if (vertexCount == 0 || indexCount == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    handle.vertexCount = vertexCount;
+    handle.indexCount = indexCount;
+
+    uint32_t firstVertex = 0;
+    Chunk* chunk = nullptr;
+    for (uint32_t i = 0; i < m_Chunks.size() && !chunk; i++)
+    {
+        Chunk* candidate = m_Chunks[i].get();
+        if (!candidate || candidate->layout != layout ||
+            !allocateRange(candidate->freeVertices, vertexCount, firstVertex))
+            continue;
+        if (!allocateRange(candidate->freeIndices, indexCount, handle.firstIndex))
+        {
+            freeRange(candidate->freeVertices, firstVertex, vertexCount);
+            continue;
+        }
+        chunk = candidate;
+        handle.chunk = i;
+    }
+
+    if (!chunk)
+    {
+        chunk = createChunk(layout, std::max(vertexCount, m_ChunkVertexCount),
+                            std::max(indexCount, m_ChunkIndexCount), handle.chunk);
+        if (!chunk)
+        {
+            handle = {};
+            return false;
+        }
+        allocateRange(chunk->freeVertices, vertexCount, firstVertex);
+        allocateRange(chunk->freeIndices, indexCount, handle.firstIndex);
+    }
+    handle.vertexOffset = static_cast<int32_t>(firstVertex);
+
+    // A move copies the whole buffer, writes while it is in flight would be lost. Waits for a move of the chunk
+    setMovable(*chunk, false);
+
+    VkDeviceSize stride = layout.stride();
+    uint64_t vertexTicket = m_UploadManager->upload(chunk->vertexBuffer, firstVertex * stride, vertexData,
+                                                    vertexCount * stride);
+    uint64_t indexTicket = m_UploadManager->upload(chunk->indexBuffer, handle.firstIndex * sizeof(uint32_t), indices,
+                                                   indexCount * sizeof(uint32_t));
+    chunk->uploadTicket = std::max(chunk->uploadTicket, std::max(vertexTicket, indexTicket));
+    if (vertexTicket == 0 || indexTicket == 0)
+    {
+        V_LOG_ERROR("Unable to upload geometry.");
+        release(handle);
+        handle = {};
+        return false;
+    }
+
+    // Tickets grow in submission order, waiting on the later one covers both uploads
+    handle.uploadTicket = std::max(vertexTicket, indexTicket);
+    m_UploadTicket = std::max(m_UploadTicket, handle.uploadTicket);
+    return true;
+}
+
+void GeometryPool::free(const GeometryHandle& handle)
+{
+    if (handle.indexCount == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Retired.push_back({handle, m_FrameCount});
+}
+
+void GeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t chunk)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (chunk >= m_Chunks.size() || !m_Chunks[chunk])
+        return;
+
+    VkBuffer vertexBuffers[] = {m_Chunks[chunk]->vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_Chunks[chunk]->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::update()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto it = m_Retired.begin(); it != m_Retired.end();)
+    {
+        if (it->frames > 0)
+        {
+            it->frames--;
+            ++it;
+            continue;
+        }
+
+        release(it->handle);
+        it = m_Retired.erase(it);
+    }
+
+    for (const std::unique_ptr<Chunk>& chunk : m_Chunks)
+    {
+        if (chunk && !chunk->movable &&
+            (m_UploadManager->isComplete(chunk->uploadTicket) || m_UploadManager->isFailed(chunk->uploadTicket)))
+            setMovable(*chunk, true);
+    }
+}
+
+size_t GeometryPool::chunkCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return liveChunkCount();
+}
+
+GeometryPool::Chunk* GeometryPool::createChunk(const VertexLayout& layout, uint32_t vertexCapacity,
+                                               uint32_t indexCapacity, uint32_t& index)
+{
+    std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>();
+    chunk->layout = layout;
+    chunk->vertexCapacity = vertexCapacity;
+    chunk->indexCapacity = indexCapacity;
+    chunk->freeVertices[0] = vertexCapacity;
+    chunk->freeIndices[0] = indexCapacity;
+
+    auto slot = std::find(m_Chunks.begin(), m_Chunks.end(), nullptr);
+    index = static_cast<uint32_t>(slot - m_Chunks.begin());
+    if (slot == m_Chunks.end())
+        m_Chunks.push_back(std::move(chunk));
+    else
+        *slot = std::move(chunk);
+
+    Chunk* created = m_Chunks[index].get();
+    if (!createBuffer(static_cast<VkDeviceSize>(vertexCapacity) * layout.stride(), VERTEX_USAGE,
+                      created->vertexBuffer, created->vertexMemory) ||
+        !createBuffer(static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t), INDEX_USAGE, created->indexBuffer,
+                      created->indexMemory))
+    {
+        V_LOG_ERROR("Unable to create geometry chunk for {} vertices and {} indices.", vertexCapacity, indexCapacity);
+        destroyChunk(index);
+        return nullptr;
+    }
+    return created;
+}
+
+void GeometryPool::destroyChunk(uint32_t index)
+{
+    Chunk* chunk = m_Chunks[index].get();
+    if (!chunk)
+        return;
+
+    setMovable(*chunk, false);
+    vkDestroyBuffer(m_Device->device(), chunk->vertexBuffer, nullptr);
+    if (chunk->vertexMemory.allocation)
+        m_Allocator->free(chunk->vertexMemory);
+    vkDestroyBuffer(m_Device->device(), chunk->indexBuffer, nullptr);
+    if (chunk->indexMemory.allocation)
+        m_Allocator->free(chunk->indexMemory);
+    m_Chunks[index].reset();
+}
+
+void GeometryPool::setMovable(Chunk& chunk, bool movable)
+{
+    if (chunk.movable == movable)
+        return;
+
+    if (movable)
+    {
+        m_Defragmenter->registerBuffer(&chunk.vertexBuffer, &chunk.vertexMemory,
+                                       static_cast<VkDeviceSize>(chunk.vertexCapacity) * chunk.layout.stride(),
+                                       VERTEX_USAGE);
+        m_Defragmenter->registerBuffer(&chunk.indexBuffer, &chunk.indexMemory,
+                                       static_cast<VkDeviceSize>(chunk.indexCapacity) * sizeof(uint32_t), INDEX_USAGE);
+    }
+    else
+    {
+        m_Defragmenter->unregisterBuffer(&chunk.vertexBuffer);
+        m_Defragmenter->unregisterBuffer(&chunk.indexBuffer);
+    }
+    chunk.movable = movable;
+}
+
+bool GeometryPool::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, MemoryBlock& memory)
+{
+    VkBufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = size;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_Device->device(), &createInfo, nullptr, &buffer) != VK_SUCCESS)
+        return false;
+
+    if (!m_Allocator->allocateForBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory))
+        return false;
+
+    return vkBindBufferMemory(m_Device->device(), buffer, memory.memory, memory.offset) == VK_SUCCESS;
+}
+
+void GeometryPool::release(const GeometryHandle& handle)
+{
+    Chunk* chunk = m_Chunks[handle.chunk].get();
+    freeRange(chunk->freeVertices, static_cast<uint32_t>(handle.vertexOffset), handle.vertexCount);
+    freeRange(chunk->freeIndices, handle.firstIndex, handle.indexCount);
+
+    // Keep one chunk around so meshes loaded later do not have to create it again
+    if (empty(*chunk) && liveChunkCount() > 1)
+    {
+        // A failed allocation may leave a copy into the chunk pending
+        m_UploadManager->wait(m_UploadTicket);
+        destroyChunk(handle.chunk);
+    }
+}
+
+bool GeometryPool::allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& first)
+{
+    auto best = freeRanges.end();
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+    {
+        if (it->second >= count && (best == freeRanges.end() || it->second < best->second))
+            best = it;
+    }
+    if (best == freeRanges.end())
+        return false;
+
+    first = best->first;
+    uint32_t remaining = best->second - count;
+    freeRanges.erase(best);
+    if (remaining > 0)
+        freeRanges[first + count] = remaining;
+    return true;
+}
+
+void GeometryPool::freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t first, uint32_t count)
+{
+    auto next = freeRanges.lower_bound(first);
+    if (next != freeRanges.end() && first + count == next->first)
+    {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    if (next != freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == first)
+        {
+            previous->second += count;
+            return;
+        }
+    }
+    freeRanges[first] = count;
+}
+
+size_t GeometryPool::liveChunkCount() const
+{
+    return std::count_if(m_Chunks.begin(), m_Chunks.end(),
+                         [](const std::unique_ptr<Chunk>& chunk) { return chunk != nullptr; });
+}
+
+bool GeometryPool::empty(const Chunk& chunk)
+{
+    return chunk.freeVertices.size() == 1 && chunk.freeVertices.begin()->second == chunk.vertexCapacity &&
+           chunk.freeIndices.size() == 1 && chunk.freeIndices.begin()->second == chunk.indexCapacity;
+}
+
+}; // namespace vrender
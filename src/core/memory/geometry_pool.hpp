@@ -0,0 +1,119 @@
+#pragma once
+
+#include "core/memory/defragmenter.hpp"
+#include "core/memory/memory_allocator.hpp"
+#include "core/memory/upload_manager.hpp"
+#include "core/vulkan/buffer.hpp"
+#include "core/vulkan/device.hpp"
+#include "utils/noncopyable.hpp"
+
+#include "vulkan/vulkan.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vrender
+{
+
+// Range of a mesh in the pool, the arguments of vkCmdDrawIndexed once the chunk is bound
+struct GeometryHandle
+{
+    uint32_t chunk = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    uint32_t indexCount = 0;
+    uint32_t vertexCount = 0;
+    uint64_t uploadTicket = 0; // For UploadManager::isComplete
+};
+
+// Suballocates the vertices and 32-bit indices of all meshes from a few large buffers, so draws of meshes in the same
+// chunk only differ in their offsets. Each chunk holds one vertex layout, meshes larger than a chunk get a chunk of
+// their own. Freed ranges are reused after the frames in flight that may draw them. Chunks whose uploads have completed
+// are registered with the defragmenter, a chunk is taken back before it is written again. allocate and free may be
+// called from any thread, update and bind belong to the render thread.
+class GeometryPool : private NonCopyable
+{
+public:
+    GeometryPool(Device* device, DeviceMemoryAllocator* allocator, UploadManager* uploadManager,
+                 Defragmenter* defragmenter, uint32_t frameCount,
+                 uint32_t chunkVertexCount = DEFAULT_CHUNK_VERTEX_COUNT,
+                 uint32_t chunkIndexCount = DEFAULT_CHUNK_INDEX_COUNT);
+    ~GeometryPool();
+
+    // vertexData holds vertexCount vertices encoded in layout, indices are relative to the first vertex. handle is
+    // empty if the allocation fails
+    bool allocate(const VertexLayout& layout, const void* vertexData, uint32_t vertexCount, const uint32_t* indices,
+                  uint32_t indexCount, GeometryHandle& handle);
+    void free(const GeometryHandle& handle);
+
+    // Binds the vertex and index buffer of a chunk
+    void bind(VkCommandBuffer commandBuffer, uint32_t chunk);
+
+    // Must be called once per frame after the fence of the frame has been waited on
+    void update();
+
+    size_t chunkCount();
+
+private:
+    struct Chunk
+    {
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        MemoryBlock vertexMemory = {};
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        MemoryBlock indexMemory = {};
+        VertexLayout layout;
+        uint32_t vertexCapacity;
+        uint32_t indexCapacity;
+        // Free ranges keyed by their first element, value is the element count
+        std::map<uint32_t, uint32_t> freeVertices;
+        std::map<uint32_t, uint32_t> freeIndices;
+        uint64_t uploadTicket = 0; // Latest upload into the chunk
+        bool movable = false;      // Registered with the defragmenter
+    };
+
+    struct Retired
+    {
+        GeometryHandle handle;
+        uint32_t frames; // Frames left until no submitted frame can draw the range
+    };
+
+    // m_Mutex must be held by everything below
+    Chunk* createChunk(const VertexLayout& layout, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t& index);
+    void destroyChunk(uint32_t index);
+    void setMovable(Chunk& chunk, bool movable);
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, MemoryBlock& memory);
+    void release(const GeometryHandle& handle);
+    size_t liveChunkCount() const;
+
+    // Best fit, returns false if no free range holds count elements
+    static bool allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& first);
+    // Merges the range with free neighbours
+    static void freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t first, uint32_t count);
+    static bool empty(const Chunk& chunk);
+
+    Device* m_Device;
+    DeviceMemoryAllocator* m_Allocator;
+    UploadManager* m_UploadManager;
+    Defragmenter* m_Defragmenter;
+
+    std::mutex m_Mutex;
+    std::vector<std::unique_ptr<Chunk>> m_Chunks; // Empty slots are reused for new chunks
+    std::vector<Retired> m_Retired;
+    uint64_t m_UploadTicket = 0; // Latest upload into any chunk
+
+    uint32_t m_FrameCount;
+    uint32_t m_ChunkVertexCount;
+    uint32_t m_ChunkIndexCount;
+
+    static constexpr uint32_t DEFAULT_CHUNK_VERTEX_COUNT = 1024 * 1024;
+    static constexpr uint32_t DEFAULT_CHUNK_INDEX_COUNT = 3 * 1024 * 1024;
+    // Moves copy from and into the chunk buffers
+    static constexpr VkBufferUsageFlags VERTEX_USAGE =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    static constexpr VkBufferUsageFlags INDEX_USAGE =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+};
+
+}; // namespace vrender
@@ -1,112 +1,235 @@
 #include "memory_allocator.hpp"
+#include "core/memory/buddy_allocation.hpp"
+#include "core/memory/dedicated_allocation.hpp"
+#include "core/memory/tlsf_allocation.hpp"
 #include "utils/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <sstream>
 #include <vulkan/vulkan_core.h>
 
 namespace vrender
 {
 
-MemoryAllocation::MemoryAllocation(Device* device, VkDeviceSize size, uint32_t memoryTypeIndex)
-    : m_Device(device->device()), m_Size(size)
+MemoryAllocation::MemoryAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                                   uint32_t memoryTypeIndex, VkBuffer dedicatedBuffer, VkImage dedicatedImage)
+    : m_Device(device), m_Functions(functions), m_Size(size), m_MemoryTypeIndex(memoryTypeIndex)
 {
-    MemoryBlock initialBlock;
-    initialBlock.typeIndex = memoryTypeIndex;
-    initialBlock.size = size;
-    initialBlock.free = true;
-    initialBlock.offset = 0;
-
     VkMemoryAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = size;
     allocInfo.memoryTypeIndex = memoryTypeIndex;
 
-    VkResult result = vkAllocateMemory(device->device(), &allocInfo, nullptr, &m_Memory);
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    if (dedicatedBuffer != VK_NULL_HANDLE || dedicatedImage != VK_NULL_HANDLE)
+    {
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.buffer = dedicatedBuffer;
+        dedicatedInfo.image = dedicatedImage;
+        allocInfo.pNext = &dedicatedInfo;
+    }
+
+    VkResult result = m_Functions.allocateMemory(m_Device, &allocInfo, nullptr, &m_Memory);
     if (result != VK_SUCCESS)
     {
         V_LOG_ERROR("Unable to allocate memory, error code: {}", result);
-        return;
+        m_Memory = VK_NULL_HANDLE;
+        m_Size = 0;
     }
-
-    initialBlock.memory = m_Memory;
-
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(device->physicalDevice(), &memoryProperties);
-
-    m_Blocks.push_back(initialBlock);
 }
 
 MemoryAllocation::~MemoryAllocation()
 {
-    vkFreeMemory(m_Device, m_Memory, nullptr);
+    if (m_Ptr)
+        m_Functions.unmapMemory(m_Device, m_Memory);
+    if (m_Memory != VK_NULL_HANDLE)
+        m_Functions.freeMemory(m_Device, m_Memory, nullptr);
 }
 
-bool MemoryAllocation::freeBlock(const MemoryBlock& block)
+bool MemoryAllocation::map()
 {
-    // TODO: MERGE CONTINUOUS BLOCKS
-    auto b = std::find(m_Blocks.begin(), m_Blocks.end(), block);
-    if (b == m_Blocks.end())
+    if (m_Ptr)
+        return true;
+
+    VkResult result = m_Functions.mapMemory(m_Device, m_Memory, 0, VK_WHOLE_SIZE, 0, &m_Ptr);
+    if (result != VK_SUCCESS)
+    {
+        V_LOG_ERROR("Unable to map memory, error code: {}", result);
+        m_Ptr = nullptr;
         return false;
-    b->free = true;
+    }
     return true;
 }
 
-bool MemoryAllocation::allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& rblock)
+MemoryBlock MemoryAllocation::createBlock(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize padding,
+                                          bool free) const
+{
+    MemoryBlock block = {};
+    block.size = size;
+    block.offset = offset;
+    block.padding = padding;
+    block.memory = m_Memory;
+    block.typeIndex = m_MemoryTypeIndex;
+    block.mapped = mappedAt(offset);
+    block.allocation = const_cast<MemoryAllocation*>(this);
+    block.free = free;
+    return block;
+}
+
+// ----------- FreeListAllocation --------------
+FreeListAllocation::FreeListAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                                       uint32_t memoryTypeIndex)
+    : MemoryAllocation(device, functions, size, memoryTypeIndex)
+{
+    if (valid())
+        insertFreeRange(0, size);
+}
+
+void FreeListAllocation::insertFreeRange(VkDeviceSize start, VkDeviceSize size)
+{
+    m_Blocks[start] = createBlock(start, size, 0, true);
+    m_FreeBlocks.emplace(size, start);
+}
+
+void FreeListAllocation::removeFreeRange(VkDeviceSize start, VkDeviceSize size)
+{
+    auto range = m_FreeBlocks.equal_range(size);
+    for (auto it = range.first; it != range.second; it++)
+    {
+        if (it->second == start)
+        {
+            m_FreeBlocks.erase(it);
+            return;
+        }
+    }
+}
+
+VkDeviceSize FreeListAllocation::largestFreeRange() const
+{
+    return m_FreeBlocks.empty() ? 0 : m_FreeBlocks.rbegin()->first;
+}
+
+void FreeListAllocation::ranges(std::vector<MemoryBlock>& ranges) const
+{
+    for (const auto& [start, block] : m_Blocks)
+        ranges.push_back(createBlock(start, block.size + block.padding, 0, block.free));
+}
+
+bool FreeListAllocation::freeBlock(const MemoryBlock& block)
 {
-    if (size > m_Size)
+    auto it = m_Blocks.find(block.offset - block.padding);
+    if (it == m_Blocks.end() || it->second.free)
         return false;
 
-    for (unsigned int i = 0; i < m_Blocks.size(); i++)
+    VkDeviceSize start = it->first;
+    VkDeviceSize size = it->second.size + it->second.padding;
+    m_AllocatedSize -= size;
+    m_WastedSize -= it->second.padding;
+
+    auto next = std::next(it);
+    if (next != m_Blocks.end() && next->second.free)
     {
-        if (m_Blocks[i].free)
+        size += next->second.size;
+        removeFreeRange(next->first, next->second.size);
+        m_Blocks.erase(next);
+    }
+
+    if (it != m_Blocks.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second.free)
         {
-            if (m_Blocks[i].offset % alignment != 0)
-            {
-                VkDeviceSize padding = (alignment - (m_Blocks[i].offset % alignment));
-                VkDeviceSize requiredSize = size + padding;
-                if (m_Blocks[i].size < requiredSize)
-                {
-                    continue;
-                }
-                VkDeviceSize newOffset = m_Blocks[i].offset + padding;
-                m_Blocks[i].offset = newOffset;
-                m_Blocks[i].size -= padding;
-            }
-            if (m_Blocks[i].size == size)
-            {
-                // Found block of same size, allocate it
-                m_Blocks[i].free = false;
-                rblock = m_Blocks[i];
-                m_AllocatedSize += size;
-                return true;
-            }
-            if (m_Blocks[i].size > size)
-            {
-                // Found block of bigger size, split it and allocate
-                MemoryBlock newBlock;
-                newBlock.size = m_Blocks[i].size - size;
-                newBlock.offset = m_Blocks[i].offset + size;
-                newBlock.memory = m_Memory;
-                newBlock.typeIndex = m_Blocks[i].typeIndex;
-                newBlock.free = true;
-                m_Blocks.push_back(newBlock);
-
-                m_Blocks[i].size = size;
-                m_Blocks[i].free = false;
-                rblock = m_Blocks[i];
-                m_AllocatedSize += size;
-                return true;
-            }
+            start = prev->first;
+            size += prev->second.size;
+            removeFreeRange(prev->first, prev->second.size);
+            m_Blocks.erase(prev);
         }
     }
-    return false;
+
+    m_Blocks.erase(it);
+    insertFreeRange(start, size);
+    return true;
 }
 
-DeviceMemoryAllocator::DeviceMemoryAllocator(Device* device, VkDeviceSize size) : m_Device(device)
+bool FreeListAllocation::allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& rblock)
 {
-    m_MemoryProperties = m_Device->memoryProperties();
-    m_PageSize = m_Device->limits().bufferImageGranularity;
-    m_MinimumAllocationSize = m_PageSize * 10;
+    if (size > remainingSize())
+        return false;
+    if (alignment == 0)
+        alignment = 1;
+
+    auto fits = [&](const std::multimap<VkDeviceSize, VkDeviceSize>::iterator& it) {
+        VkDeviceSize padding = (alignment - (it->second % alignment)) % alignment;
+        return it->first >= size + padding;
+    };
+
+    // Best fit, if alignment padding makes the smallest candidate too small, any range of
+    // size + alignment - 1 is guaranteed to fit
+    auto candidate = m_FreeBlocks.lower_bound(size);
+    if (candidate != m_FreeBlocks.end() && !fits(candidate))
+        candidate = m_FreeBlocks.lower_bound(size + alignment - 1);
+    if (candidate == m_FreeBlocks.end())
+        return false;
+
+    VkDeviceSize start = candidate->second;
+    VkDeviceSize rangeSize = candidate->first;
+    VkDeviceSize padding = (alignment - (start % alignment)) % alignment;
+    m_FreeBlocks.erase(candidate);
+
+    MemoryBlock& block = m_Blocks[start];
+    block.offset = start + padding;
+    block.padding = padding;
+    block.size = size;
+    block.mapped = mappedAt(block.offset);
+    block.free = false;
+
+    VkDeviceSize remaining = rangeSize - padding - size;
+    if (remaining > 0)
+        insertFreeRange(block.offset + size, remaining);
+
+    m_AllocatedSize += padding + size;
+    m_WastedSize += padding;
+    rblock = m_Blocks[start];
+    return true;
+}
+
+// Recently freed small blocks of one thread, reused by its next allocations of the same size
+// Held by exiting threads while they return their cache and by the allocator destructor while it detaches the caches,
+// so a thread never returns its blocks to an allocator that is being destroyed
+static std::mutex threadCacheLifetimeMutex;
+
+struct DeviceMemoryAllocator::ThreadCache
+{
+    ~ThreadCache();
+
+    DeviceMemoryAllocator* allocator = nullptr;
+    std::mutex mutex; // Only contended while update returns the cached blocks
+    std::vector<MemoryBlock> blocks;
+};
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(Device* device, VkDeviceSize size)
+    : DeviceMemoryAllocator(device->device(), device->memoryProperties(), device->limits().bufferImageGranularity)
+{
+    m_Size = size;
+    m_NonCoherentAtomSize = device->limits().nonCoherentAtomSize;
+    m_PhysicalDevice = device->physicalDevice();
+    m_BudgetSupported = device->isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    updateBudget();
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                             VkDeviceSize bufferImageGranularity,
+                                             const DeviceMemoryFunctions& functions)
+    : m_Device(device), m_Functions(functions), m_Size(0), m_MemoryProperties(memoryProperties),
+      m_BufferImageGranularity(bufferImageGranularity)
+{
+    m_MinimumAllocationSize = std::max(m_BufferImageGranularity * 10, MINIMUM_ALLOCATION_SIZE);
 
     m_Allocations.resize(m_MemoryProperties.memoryTypeCount);
+    m_EmptyAllocations.resize(m_MemoryProperties.memoryTypeCount);
+    m_Strategies.resize(m_MemoryProperties.memoryTypeCount, AllocationStrategy::FreeList);
 
     m_MemoryTypes.resize(m_MemoryProperties.memoryTypeCount);
     for (unsigned int i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
@@ -126,16 +249,38 @@ DeviceMemoryAllocator::DeviceMemoryAllocator(Device* device, VkDeviceSize size)
 
 DeviceMemoryAllocator::~DeviceMemoryAllocator()
 {
-    for (const MemoryAllocation* alloc : m_Allocations)
+    // Cached blocks were freed by their owners, return them so only real leaks are reported
+    {
+        std::lock_guard<std::mutex> lifetimeLock(threadCacheLifetimeMutex);
+        std::lock_guard<std::mutex> lock(m_CacheMutex);
+        for (ThreadCache* cache : m_ThreadCaches)
+        {
+            std::lock_guard<std::mutex> cacheLock(cache->mutex);
+            cache->allocator = nullptr;
+            for (const MemoryBlock& block : cache->blocks)
+                freeToAllocation(block);
+            cache->blocks.clear();
+        }
+        m_ThreadCaches.clear();
+    }
+
+    reportLeaks();
+
+    for (MemoryAllocation* alloc : m_DedicatedAllocations)
+    {
+        destroyAllocation(alloc);
+    }
+
+    for (MemoryAllocation* alloc : m_Allocations)
     {
         if (!alloc)
             continue;
 
-        const MemoryAllocation* next = alloc;
+        MemoryAllocation* next = alloc;
         do
         {
             next = alloc->next();
-            delete alloc;
+            destroyAllocation(alloc);
             alloc = next;
         } while (next);
     }
@@ -154,69 +299,869 @@ uint64_t DeviceMemoryAllocator::nextPowerOfTwo(uint64_t num)
     return num;
 }
 
-MemoryAllocation* DeviceMemoryAllocator::allocateNewMemory(VkDeviceSize size, uint32_t memoryTypeIndex)
+void DeviceMemoryAllocator::setStrategy(uint32_t memoryTypeIndex, AllocationStrategy strategy)
 {
-    MemoryAllocation* allocation = m_Allocations[memoryTypeIndex];
-    VkDeviceSize allocSize;
+    m_Strategies[memoryTypeIndex] = strategy;
+}
 
-    if (!allocation)
+MemoryAllocation* DeviceMemoryAllocator::createAllocation(VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+    MemoryAllocation* allocation = nullptr;
+    switch (m_Strategies[memoryTypeIndex])
     {
-        allocSize = size > m_MinimumAllocationSize ? size : m_MinimumAllocationSize;
-        MemoryAllocation* alloc = new MemoryAllocation(m_Device, allocSize, memoryTypeIndex);
-        m_Allocations[memoryTypeIndex] = alloc;
-        return alloc;
+    case AllocationStrategy::Tlsf:
+        allocation = new TlsfAllocation(m_Device, m_Functions, size, memoryTypeIndex);
+        break;
+    case AllocationStrategy::Buddy:
+        allocation = new BuddyAllocation(m_Device, m_Functions, isPowerOfTwo(size) ? size : nextPowerOfTwo(size),
+                                         memoryTypeIndex);
+        break;
+    case AllocationStrategy::FreeList:
+    default:
+        allocation = new FreeListAllocation(m_Device, m_Functions, size, memoryTypeIndex);
+        break;
     }
-    else
+
+    if (!allocation->valid() || (isHostVisible(memoryTypeIndex) && !allocation->map()))
     {
-        while (allocation->next() != nullptr)
-            allocation = allocation->next();
+        delete allocation;
+        return nullptr;
+    }
 
-        allocSize = size > (allocation->size() * 2) ? size : allocation->size() * 2;
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    m_MemoryHeaps[m_MemoryTypes[memoryTypeIndex].heapIndex].allocatedSize += allocation->size();
+    return allocation;
+}
 
-        MemoryAllocation* alloc = new MemoryAllocation(m_Device, allocSize, memoryTypeIndex);
-        allocation->setNext(alloc);
-        return alloc;
+void DeviceMemoryAllocator::destroyAllocation(MemoryAllocation* allocation)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_HeapMutex);
+        m_MemoryHeaps[m_MemoryTypes[allocation->memoryTypeIndex()].heapIndex].allocatedSize -= allocation->size();
     }
+    delete allocation;
 }
 
-MemoryAllocation* DeviceMemoryAllocator::findSuitableAllocation(VkDeviceSize size, uint32_t memoryTypeIndex)
+MemoryAllocation* DeviceMemoryAllocator::allocateNewMemory(VkDeviceSize size, uint32_t memoryTypeIndex,
+                                                            ResourceTiling tiling)
 {
     MemoryAllocation* allocation = m_Allocations[memoryTypeIndex];
+    VkDeviceSize allocSize = m_MinimumAllocationSize;
+
+    // Grow from the last allocation holding the same kind of resources
+    if (allocation)
+    {
+        for (;; allocation = allocation->next())
+        {
+            if (compatible(allocation, tiling))
+                allocSize = allocation->size() * 2;
+            if (!allocation->next())
+                break;
+        }
+    }
+    if (size * 2 > allocSize)
+        allocSize = size * 2;
 
+    // Rounded before the budget check, rounding a clamped size up again would go over budget
+    bool buddy = m_Strategies[memoryTypeIndex] == AllocationStrategy::Buddy;
+    if (buddy && !isPowerOfTwo(allocSize))
+        allocSize = nextPowerOfTwo(allocSize);
+
+    // Grow by less than usual rather than go over budget
+    VkDeviceSize available = availableBudget(m_MemoryTypes[memoryTypeIndex].heapIndex);
+    if (size > available)
+        return nullptr;
+    if (allocSize > available)
+        allocSize = buddy ? nextPowerOfTwo(available + 1) >> 1 : available; // Largest power of two that fits
+
+    MemoryAllocation* alloc = createAllocation(allocSize, memoryTypeIndex);
+    if (!alloc)
+        return nullptr;
+    alloc->setTiling(tiling);
     if (!allocation)
+        m_Allocations[memoryTypeIndex] = alloc;
+    else
+        allocation->setNext(alloc);
+    return alloc;
+}
+
+VkDeviceSize DeviceMemoryAllocator::availableBudget(uint32_t heapIndex) const
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    const Heap& heap = m_MemoryHeaps[heapIndex];
+    return heap.budgetSize > heap.usage() ? heap.budgetSize - heap.usage() : 0;
+}
+
+bool DeviceMemoryAllocator::ensureBudget(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    uint32_t heapIndex = m_MemoryTypes[memoryTypeIndex].heapIndex;
+    if (availableBudget(heapIndex) >= size)
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_BudgetHandlerMutex);
+    for (MemoryBudgetHandler* handler : m_BudgetHandlers)
     {
-        // Initial allocation for this memory type
-        allocation = allocateNewMemory(size * 2, memoryTypeIndex);
-        return allocation;
+        handler->evict(heapIndex, size - availableBudget(heapIndex));
+        if (availableBudget(heapIndex) >= size)
+            return true;
     }
 
-    while (allocation && allocation->remainingSize() < size)
+    V_LOG_WARNING("Memory heap {} over budget, {} bytes requested.", heapIndex, size);
+    return false;
+}
+
+void DeviceMemoryAllocator::updateBudget()
+{
+    if (!m_BudgetSupported)
+        return;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
+
+    vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memoryProperties);
+
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    for (unsigned int i = 0; i < m_MemoryHeaps.size(); i++)
     {
-        allocation = allocation->next();
+        m_MemoryHeaps[i].budgetSize = budgetProperties.heapBudget[i];
+        // Kept apart so the allocations made and freed until the next update do not count twice
+        VkDeviceSize allocatedSize = m_MemoryHeaps[i].allocatedSize;
+        VkDeviceSize usage = budgetProperties.heapUsage[i];
+        m_MemoryHeaps[i].externalUsage = usage > allocatedSize ? usage - allocatedSize : 0;
     }
+}
 
-    if (!allocation)
+void DeviceMemoryAllocator::registerBudgetHandler(MemoryBudgetHandler* handler)
+{
+    std::lock_guard<std::mutex> lock(m_BudgetHandlerMutex);
+    m_BudgetHandlers.push_back(handler);
+}
+
+void DeviceMemoryAllocator::unregisterBudgetHandler(MemoryBudgetHandler* handler)
+{
+    std::lock_guard<std::mutex> lock(m_BudgetHandlerMutex);
+    m_BudgetHandlers.erase(std::remove(m_BudgetHandlers.begin(), m_BudgetHandlers.end(), handler),
+                           m_BudgetHandlers.end());
+}
+
+MemoryTypeStats DeviceMemoryAllocator::stats(uint32_t memoryTypeIndex) const
+{
+    MemoryTypeStats stats = {};
     {
-        // No allocation has space, allocate new
-        allocation = allocateNewMemory(size * 2, memoryTypeIndex);
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[memoryTypeIndex]);
+        for (MemoryAllocation* allocation = m_Allocations[memoryTypeIndex]; allocation; allocation = allocation->next())
+        {
+            stats.reservedSize += allocation->size();
+            stats.allocatedSize += allocation->allocatedSize();
+            stats.wastedSize += allocation->wastedSize();
+            stats.largestFreeRange = std::max(stats.largestFreeRange, allocation->largestFreeRange());
+            stats.allocationCount++;
+        }
     }
 
-    return allocation;
+    // Blocks held by thread caches count as allocated until update returns them
+    VkDeviceSize freeSize = stats.reservedSize - stats.allocatedSize;
+    if (freeSize > 0)
+        stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / freeSize;
+
+    const OperationCounters& counters = m_Counters[memoryTypeIndex];
+    stats.allocateCount = counters.allocateCount;
+    stats.freeCount = counters.freeCount;
+    stats.blockCount = stats.allocateCount - stats.freeCount;
+    stats.allocateTime = counters.allocateTime;
+    stats.freeTime = counters.freeTime;
+
+    std::lock_guard<std::mutex> lock(m_DedicatedMutex);
+    for (MemoryAllocation* allocation : m_DedicatedAllocations)
+    {
+        if (allocation->memoryTypeIndex() != memoryTypeIndex)
+            continue;
+        stats.reservedSize += allocation->size();
+        stats.allocatedSize += allocation->allocatedSize();
+        stats.wastedSize += allocation->wastedSize();
+        stats.allocationCount++;
+        stats.dedicatedCount++;
+    }
+    return stats;
+}
+
+HeapStats DeviceMemoryAllocator::heapStats(uint32_t heapIndex) const
+{
+    HeapStats heapStats = {};
+    VkDeviceSize freeSize = 0;
+    for (uint32_t i = 0; i < m_MemoryTypes.size(); i++)
+    {
+        if (m_MemoryTypes[i].heapIndex != heapIndex)
+            continue;
+
+        MemoryTypeStats typeStats = stats(i);
+        MemoryTypeStats& total = heapStats.types;
+        total.reservedSize += typeStats.reservedSize;
+        total.allocatedSize += typeStats.allocatedSize;
+        total.wastedSize += typeStats.wastedSize;
+        total.largestFreeRange = std::max(total.largestFreeRange, typeStats.largestFreeRange);
+        total.allocationCount += typeStats.allocationCount;
+        total.dedicatedCount += typeStats.dedicatedCount;
+        total.blockCount += typeStats.blockCount;
+        total.allocateCount += typeStats.allocateCount;
+        total.freeCount += typeStats.freeCount;
+        total.allocateTime += typeStats.allocateTime;
+        total.freeTime += typeStats.freeTime;
+        freeSize += typeStats.reservedSize - typeStats.allocatedSize;
+    }
+    if (freeSize > 0)
+        heapStats.types.fragmentation = 1.0f - static_cast<float>(heapStats.types.largestFreeRange) / freeSize;
+
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    heapStats.budgetSize = m_MemoryHeaps[heapIndex].budgetSize;
+    heapStats.usage = m_MemoryHeaps[heapIndex].usage();
+    return heapStats;
+}
+
+static void writeJson(std::ostringstream& out, const MemoryTypeStats& stats)
+{
+    out << "\"reservedSize\":" << stats.reservedSize << ",\"allocatedSize\":" << stats.allocatedSize
+        << ",\"wastedSize\":" << stats.wastedSize << ",\"largestFreeRange\":" << stats.largestFreeRange
+        << ",\"fragmentation\":" << stats.fragmentation << ",\"allocationCount\":" << stats.allocationCount
+        << ",\"dedicatedCount\":" << stats.dedicatedCount << ",\"blockCount\":" << stats.blockCount
+        << ",\"allocateCount\":" << stats.allocateCount << ",\"freeCount\":" << stats.freeCount
+        << ",\"allocateTime\":" << stats.allocateTime << ",\"freeTime\":" << stats.freeTime;
+}
+
+static void writeJson(std::ostringstream& out, const MemoryAllocation* allocation, std::vector<MemoryBlock>& ranges)
+{
+    ranges.clear();
+    allocation->ranges(ranges);
+
+    out << "{\"size\":" << allocation->size() << ",\"dedicated\":" << (allocation->dedicated() ? "true" : "false")
+        << ",\"ranges\":[";
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        out << (i ? "," : "") << "{\"offset\":" << ranges[i].offset << ",\"size\":" << ranges[i].size
+            << ",\"free\":" << (ranges[i].free ? "true" : "false") << "}";
+    }
+    out << "]}";
+}
+
+std::string DeviceMemoryAllocator::dumpJson() const
+{
+    std::ostringstream out;
+    std::vector<MemoryBlock> ranges;
+
+    out << "{\"heaps\":[";
+    for (uint32_t i = 0; i < m_MemoryHeaps.size(); i++)
+    {
+        HeapStats heap = heapStats(i);
+        out << (i ? "," : "") << "{\"index\":" << i << ",\"size\":" << m_MemoryHeaps[i].size
+            << ",\"budgetSize\":" << heap.budgetSize << ",\"usage\":" << heap.usage << ",";
+        writeJson(out, heap.types);
+        out << "}";
+    }
+
+    out << "],\"types\":[";
+    for (uint32_t i = 0; i < m_MemoryTypes.size(); i++)
+    {
+        out << (i ? "," : "") << "{\"index\":" << i << ",\"heapIndex\":" << m_MemoryTypes[i].heapIndex
+            << ",\"propertyFlags\":" << m_MemoryTypes[i].propertyFlags << ",";
+        writeJson(out, stats(i));
+
+        out << ",\"allocations\":[";
+        bool first = true;
+        {
+            std::lock_guard<std::mutex> lock(m_TypeMutexes[i]);
+            for (MemoryAllocation* allocation = m_Allocations[i]; allocation; allocation = allocation->next())
+            {
+                out << (first ? "" : ",");
+                writeJson(out, allocation, ranges);
+                first = false;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_DedicatedMutex);
+            for (MemoryAllocation* allocation : m_DedicatedAllocations)
+            {
+                if (allocation->memoryTypeIndex() != i)
+                    continue;
+                out << (first ? "" : ",");
+                writeJson(out, allocation, ranges);
+                first = false;
+            }
+        }
+        out << "]}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+std::vector<MemoryBlock> DeviceMemoryAllocator::leakedBlocks() const
+{
+    std::vector<MemoryBlock> blocks;
+    std::vector<MemoryBlock> ranges;
+    for (uint32_t i = 0; i < m_MemoryTypes.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[i]);
+        for (MemoryAllocation* allocation = m_Allocations[i]; allocation; allocation = allocation->next())
+        {
+            ranges.clear();
+            allocation->ranges(ranges);
+            for (const MemoryBlock& range : ranges)
+            {
+                if (!range.free)
+                    blocks.push_back(range);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_DedicatedMutex);
+    for (MemoryAllocation* allocation : m_DedicatedAllocations)
+    {
+        MemoryBlock block = {};
+        block.size = allocation->size();
+        block.memory = allocation->memory();
+        block.typeIndex = allocation->memoryTypeIndex();
+        block.allocation = allocation;
+        blocks.push_back(block);
+    }
+    return blocks;
+}
+
+void DeviceMemoryAllocator::reportLeaks() const
+{
+    for (uint32_t i = 0; i < m_MemoryTypes.size(); i++)
+    {
+        const OperationCounters& counters = m_Counters[i];
+        uint64_t leaked = counters.allocateCount - counters.freeCount;
+        if (leaked > 0)
+            V_LOG_WARNING("{} memory blocks of type {} were not freed.", leaked, i);
+    }
+
+    for (const MemoryBlock& block : leakedBlocks())
+    {
+        if (block.allocation->dedicated())
+            V_LOG_WARNING("Leaked dedicated block of {} bytes of memory type {}.", block.size, block.typeIndex);
+        else
+            V_LOG_WARNING("Leaked block of {} bytes at offset {} of memory type {}.", block.size, block.offset,
+                          block.typeIndex);
+    }
+}
+
+static uint64_t elapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 }
 
 bool DeviceMemoryAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
-                                     MemoryBlock& block)
+                                     MemoryBlock& block, ResourceTiling tiling)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Linear and optimal resources never share an allocation, so blocks only need their own alignment
+    bool result = size >= m_DedicatedThreshold
+                      ? createDedicated(size, memoryTypeIndex, VK_NULL_HANDLE, VK_NULL_HANDLE, block)
+                      : suballocate(size, alignment, memoryTypeIndex, tiling, block);
+
+    if (result)
+    {
+        m_Counters[memoryTypeIndex].allocateCount++;
+        m_Counters[memoryTypeIndex].allocateTime += elapsedNanoseconds(start);
+    }
+    return result;
+}
+
+bool DeviceMemoryAllocator::suballocate(VkDeviceSize requestSize, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                                        ResourceTiling tiling, MemoryBlock& block)
 {
-    VkDeviceSize requestSize = ((size / m_PageSize) + 1) * m_PageSize;
+    alignRequest(memoryTypeIndex, requestSize, alignment);
+
+    if (allocateFromCache(requestSize, alignment, memoryTypeIndex, tiling, block))
+        return true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[memoryTypeIndex]);
+        if (allocateFromExisting(requestSize, alignment, memoryTypeIndex, tiling, block))
+            return true;
+    }
 
-    MemoryAllocation* suitableAllocation = findSuitableAllocation(requestSize, memoryTypeIndex);
+    // Buddy allocations are powers of two, so the budget is checked for the size the memory will really have
+    VkDeviceSize memorySize = requestSize + alignment;
+    if (m_Strategies[memoryTypeIndex] == AllocationStrategy::Buddy && !isPowerOfTwo(memorySize))
+        memorySize = nextPowerOfTwo(memorySize);
 
-    return suitableAllocation->allocateBlock(requestSize, alignment, block);
+    // No allocation has space, allocate new if the budget allows. Budget handlers may free memory of
+    // this type, so the lock is not held while they run
+    bool withinBudget = ensureBudget(memoryTypeIndex, memorySize);
+
+    std::lock_guard<std::mutex> lock(m_TypeMutexes[memoryTypeIndex]);
+    // Another thread or evicted resources may have left a range large enough behind
+    if (allocateFromExisting(requestSize, alignment, memoryTypeIndex, tiling, block))
+        return true;
+    if (!withinBudget)
+        return false;
+
+    MemoryAllocation* allocation = allocateNewMemory(memorySize, memoryTypeIndex, tiling);
+    if (!allocation)
+        return false;
+    return allocation->allocateBlock(requestSize, alignment, block);
+}
+
+bool DeviceMemoryAllocator::allocateExcluding(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                                              const MemoryAllocation* excluded, MemoryBlock& block)
+{
+    VkDeviceSize requestSize = size;
+    alignRequest(memoryTypeIndex, requestSize, alignment);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[memoryTypeIndex]);
+        if (!allocateFromExisting(requestSize, alignment, memoryTypeIndex, ResourceTiling::Linear, block, excluded))
+            return false;
+    }
+
+    m_Counters[memoryTypeIndex].allocateCount++;
+    m_Counters[memoryTypeIndex].allocateTime += elapsedNanoseconds(start);
+    return true;
+}
+
+bool DeviceMemoryAllocator::allocateFromExisting(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                                                 ResourceTiling tiling, MemoryBlock& block,
+                                                 const MemoryAllocation* excluded)
+{
+    // remainingSize only tells whether the bytes exist, the allocation itself knows if a contiguous range does
+    for (MemoryAllocation* allocation = m_Allocations[memoryTypeIndex]; allocation; allocation = allocation->next())
+    {
+        if (allocation != excluded && compatible(allocation, tiling) && allocation->remainingSize() >= size &&
+            allocation->allocateBlock(size, alignment, block))
+            return true;
+    }
+    return false;
+}
+
+bool DeviceMemoryAllocator::contains(const MemoryAllocation* allocation) const
+{
+    for (uint32_t i = 0; i < m_Allocations.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[i]);
+        for (MemoryAllocation* next = m_Allocations[i]; next; next = next->next())
+        {
+            if (next == allocation)
+                return true;
+        }
+    }
+    return false;
+}
+
+void DeviceMemoryAllocator::alignRequest(uint32_t memoryTypeIndex, VkDeviceSize& size, VkDeviceSize& alignment) const
+{
+    // Keep flushing one block from touching atoms shared with its neighbours
+    if (isNonCoherent(memoryTypeIndex))
+    {
+        alignment = std::max(alignment, m_NonCoherentAtomSize);
+        size = ((size + m_NonCoherentAtomSize - 1) / m_NonCoherentAtomSize) * m_NonCoherentAtomSize;
+    }
+}
+
+bool DeviceMemoryAllocator::releaseAllocation(MemoryAllocation* allocation)
+{
+    if (allocation->dedicated())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_TypeMutexes[allocation->memoryTypeIndex()]);
+    return unlinkAllocation(allocation);
+}
+
+bool DeviceMemoryAllocator::unlinkAllocation(MemoryAllocation* allocation)
+{
+    uint32_t memoryTypeIndex = allocation->memoryTypeIndex();
+
+    MemoryAllocation* prev = nullptr;
+    MemoryAllocation* current = m_Allocations[memoryTypeIndex];
+    while (current && current != allocation)
+    {
+        prev = current;
+        current = current->next();
+    }
+    if (!current || allocation->allocatedSize() != 0)
+        return false;
+
+    if (prev)
+        prev->setNext(allocation->next());
+    else
+        m_Allocations[memoryTypeIndex] = allocation->next();
+
+    m_EmptyAllocations[memoryTypeIndex].erase(allocation);
+    destroyAllocation(allocation);
+    return true;
+}
+
+bool DeviceMemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer,
+                                              VkImage image, MemoryBlock& block)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (!createDedicated(size, memoryTypeIndex, buffer, image, block))
+        return false;
+
+    m_Counters[memoryTypeIndex].allocateCount++;
+    m_Counters[memoryTypeIndex].allocateTime += elapsedNanoseconds(start);
+    return true;
+}
+
+bool DeviceMemoryAllocator::createDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer,
+                                            VkImage image, MemoryBlock& block)
+{
+    if (!ensureBudget(memoryTypeIndex, size))
+        return false;
+
+    MemoryAllocation* allocation = new DedicatedAllocation(m_Device, m_Functions, size, memoryTypeIndex, buffer, image);
+    if (!allocation->valid() || (isHostVisible(memoryTypeIndex) && !allocation->map()) ||
+        !allocation->allocateBlock(size, 1, block))
+    {
+        delete allocation;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_HeapMutex);
+        m_MemoryHeaps[m_MemoryTypes[memoryTypeIndex].heapIndex].allocatedSize += allocation->size();
+    }
+
+    std::lock_guard<std::mutex> lock(m_DedicatedMutex);
+    m_DedicatedAllocations.insert(allocation);
+    return true;
+}
+
+bool DeviceMemoryAllocator::allocateForRequirements(const VkMemoryRequirements& requirements, bool dedicated,
+                                                    VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image,
+                                                    ResourceTiling tiling, MemoryBlock& block)
+{
+    // Memory types are tried in order of preference, falling back to the next one when a heap is over budget
+    uint32_t typeFilter = requirements.memoryTypeBits;
+    uint32_t typeIndex;
+    while (findMemoryType(typeFilter, properties, typeIndex))
+    {
+        if (dedicated || requirements.size >= m_DedicatedThreshold)
+        {
+            if (allocateDedicated(requirements.size, typeIndex, buffer, image, block))
+                return true;
+        }
+        else if (allocate(requirements.size, requirements.alignment, typeIndex, block, tiling))
+        {
+            return true;
+        }
+        typeFilter &= ~(1u << typeIndex);
+    }
+
+    // Lazily allocated memory is only a saving where the device has it, transient images work in any memory
+    if (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+    {
+        V_LOG_DEBUG("No lazily allocated memory available, falling back to regular memory.");
+        return allocateForRequirements(requirements, dedicated, properties & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                       buffer, image, tiling, block);
+    }
+
+    V_LOG_ERROR("Failed to find memory type with space for {} bytes.", requirements.size);
+    return false;
+}
+
+bool DeviceMemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryBlock& block)
+{
+    VkMemoryDedicatedRequirements dedicatedRequirements = {};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 memoryRequirements = {};
+    memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memoryRequirements.pNext = &dedicatedRequirements;
+
+    VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.buffer = buffer;
+
+    vkGetBufferMemoryRequirements2(m_Device, &requirementsInfo, &memoryRequirements);
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    return allocateForRequirements(memoryRequirements.memoryRequirements, dedicated, properties, buffer,
+                                   VK_NULL_HANDLE, ResourceTiling::Linear, block);
+}
+
+bool DeviceMemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties, MemoryBlock& block,
+                                             ResourceTiling tiling)
+{
+    VkMemoryDedicatedRequirements dedicatedRequirements = {};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 memoryRequirements = {};
+    memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memoryRequirements.pNext = &dedicatedRequirements;
+
+    VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.image = image;
+
+    vkGetImageMemoryRequirements2(m_Device, &requirementsInfo, &memoryRequirements);
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    return allocateForRequirements(memoryRequirements.memoryRequirements, dedicated, properties, VK_NULL_HANDLE,
+                                   image, tiling, block);
 }
 
 void DeviceMemoryAllocator::free(const MemoryBlock& block)
 {
-    m_Allocations[block.typeIndex]->freeBlock(block);
+    if (!block.allocation)
+    {
+        V_LOG_WARNING("Tried to free memory block not owned by allocator.");
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (freeBlock(block))
+    {
+        m_Counters[block.typeIndex].freeCount++;
+        m_Counters[block.typeIndex].freeTime += elapsedNanoseconds(start);
+    }
+}
+
+bool DeviceMemoryAllocator::freeBlock(const MemoryBlock& block)
+{
+    if (block.allocation->dedicated())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_DedicatedMutex);
+            if (!m_DedicatedAllocations.erase(block.allocation) || !block.allocation->freeBlock(block))
+            {
+                V_LOG_WARNING("Tried to free memory block not owned by allocator.");
+                return false;
+            }
+        }
+        destroyAllocation(block.allocation);
+        return true;
+    }
+
+    if (cacheBlock(block))
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_TypeMutexes[block.typeIndex]);
+    return freeToAllocation(block);
+}
+
+bool DeviceMemoryAllocator::freeToAllocation(const MemoryBlock& block)
+{
+    if (!block.allocation->freeBlock(block))
+    {
+        V_LOG_WARNING("Tried to free memory block not owned by allocator.");
+        return false;
+    }
+
+    if (block.allocation->allocatedSize() == 0)
+        m_EmptyAllocations[block.typeIndex][block.allocation] = m_ReleaseDelay;
+    return true;
+}
+
+void DeviceMemoryAllocator::update()
+{
+    flushThreadCaches();
+    updateBudget();
+
+    for (uint32_t i = 0; i < m_EmptyAllocations.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[i]);
+        for (auto it = m_EmptyAllocations[i].begin(); it != m_EmptyAllocations[i].end();)
+        {
+            MemoryAllocation* allocation = it->first;
+            // Allocated from again within the delay, keep it until it is emptied again
+            if (allocation->allocatedSize() != 0)
+            {
+                it = m_EmptyAllocations[i].erase(it);
+            }
+            else if (it->second == 0 || --it->second == 0)
+            {
+                it = m_EmptyAllocations[i].erase(it);
+                unlinkAllocation(allocation);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+}
+
+// ----------- Thread caches --------------
+DeviceMemoryAllocator::ThreadCache::~ThreadCache()
+{
+    // The owner cannot be destroyed before the cache is released, its destructor takes the same lock
+    std::lock_guard<std::mutex> lifetimeLock(threadCacheLifetimeMutex);
+    DeviceMemoryAllocator* owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        owner = allocator;
+    }
+    if (owner)
+        owner->releaseThreadCache(this);
+}
+
+DeviceMemoryAllocator::ThreadCache& DeviceMemoryAllocator::threadCache()
+{
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+bool DeviceMemoryAllocator::allocateFromCache(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                                              ResourceTiling tiling, MemoryBlock& block)
+{
+    if (!m_ThreadCacheEnabled || size > THREAD_CACHE_MAX_BLOCK_SIZE)
+        return false;
+    if (alignment == 0)
+        alignment = 1;
+
+    ThreadCache& cache = threadCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.allocator != this)
+        return false;
+
+    for (size_t i = 0; i < cache.blocks.size(); i++)
+    {
+        const MemoryBlock& cached = cache.blocks[i];
+        if (cached.typeIndex == memoryTypeIndex && cached.size == size && cached.offset % alignment == 0 &&
+            compatible(cached.allocation, tiling))
+        {
+            block = cached;
+            cache.blocks[i] = cache.blocks.back();
+            cache.blocks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DeviceMemoryAllocator::cacheBlock(const MemoryBlock& block)
+{
+    if (!m_ThreadCacheEnabled || block.size > THREAD_CACHE_MAX_BLOCK_SIZE)
+        return false;
+
+    ThreadCache& cache = threadCache();
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if (cache.allocator == this)
+        {
+            if (cache.blocks.size() >= THREAD_CACHE_SIZE)
+                return false;
+            cache.blocks.push_back(block);
+            return true;
+        }
+        if (cache.allocator != nullptr)
+            return false;
+    }
+
+    // First block freed on this thread, register the cache so update can return its blocks
+    std::lock_guard<std::mutex> lock(m_CacheMutex);
+    std::lock_guard<std::mutex> cacheLock(cache.mutex);
+    m_ThreadCaches.insert(&cache);
+    cache.allocator = this;
+    cache.blocks.push_back(block);
+    return true;
+}
+
+void DeviceMemoryAllocator::flushThreadCaches()
+{
+    std::vector<MemoryBlock> blocks;
+    {
+        std::lock_guard<std::mutex> lock(m_CacheMutex);
+        for (ThreadCache* cache : m_ThreadCaches)
+        {
+            std::lock_guard<std::mutex> cacheLock(cache->mutex);
+            blocks.insert(blocks.end(), cache->blocks.begin(), cache->blocks.end());
+            cache->blocks.clear();
+        }
+    }
+
+    for (const MemoryBlock& block : blocks)
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[block.typeIndex]);
+        freeToAllocation(block);
+    }
+}
+
+void DeviceMemoryAllocator::releaseThreadCache(ThreadCache* cache)
+{
+    std::vector<MemoryBlock> blocks;
+    {
+        std::lock_guard<std::mutex> lock(m_CacheMutex);
+        if (!m_ThreadCaches.erase(cache))
+            return;
+
+        std::lock_guard<std::mutex> cacheLock(cache->mutex);
+        blocks.swap(cache->blocks);
+        cache->allocator = nullptr;
+    }
+
+    for (const MemoryBlock& block : blocks)
+    {
+        std::lock_guard<std::mutex> lock(m_TypeMutexes[block.typeIndex]);
+        freeToAllocation(block);
+    }
+}
+
+bool DeviceMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags, uint32_t& typeIndex) const
+{
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+    {
+        if (typeFilter & (1 << i) && (m_MemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+        {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DeviceMemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+{
+    return m_MemoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+bool DeviceMemoryAllocator::isNonCoherent(uint32_t memoryTypeIndex) const
+{
+    return isHostVisible(memoryTypeIndex) &&
+           !(m_MemoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+VkMappedMemoryRange DeviceMemoryAllocator::mappedRange(const MemoryBlock& block, VkDeviceSize offset,
+                                                       VkDeviceSize size) const
+{
+    VkDeviceSize start = block.offset + offset;
+    VkDeviceSize end = size == VK_WHOLE_SIZE ? block.offset + block.size : start + size;
+
+    start = (start / m_NonCoherentAtomSize) * m_NonCoherentAtomSize;
+    end = ((end + m_NonCoherentAtomSize - 1) / m_NonCoherentAtomSize) * m_NonCoherentAtomSize;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = block.memory;
+    range.offset = start;
+    // Ranges ending at the end of the memory object need not be a multiple of the atom size
+    range.size = end >= block.allocation->size() ? VK_WHOLE_SIZE : end - start;
+    return range;
+}
+
+bool DeviceMemoryAllocator::flush(const MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!isNonCoherent(block.typeIndex))
+        return true;
+
+    VkMappedMemoryRange range = mappedRange(block, offset, size);
+    return m_Functions.flushMappedMemoryRanges(m_Device, 1, &range) == VK_SUCCESS;
+}
+
+bool DeviceMemoryAllocator::invalidate(const MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!isNonCoherent(block.typeIndex))
+        return true;
+
+    VkMappedMemoryRange range = mappedRange(block, offset, size);
+    return m_Functions.invalidateMappedMemoryRanges(m_Device, 1, &range) == VK_SUCCESS;
 }
 
 bool DeviceMemoryAllocator::findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
@@ -5,19 +5,33 @@
 
 #include "vulkan/vulkan.h"
 
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace vrender
 {
 
+class MemoryAllocation;
+
 struct MemoryBlock
 {
     VkDeviceSize size;
     VkDeviceSize offset;
+    VkDeviceSize padding; // Bytes in front of offset skipped for alignment, returned on free
 
     VkDeviceMemory memory;
     uint32_t typeIndex;
 
+    void* mapped; // CPU address of offset if the memory type is host visible, otherwise nullptr
+
+    MemoryAllocation* allocation;
+
     bool free;
 
     bool operator==(const MemoryBlock& other)
@@ -26,71 +40,330 @@ struct MemoryBlock
     }
 };
 
+// Device memory entry points used by the allocator, can be replaced to run the allocator without a GPU
+struct DeviceMemoryFunctions
+{
+    PFN_vkAllocateMemory allocateMemory = vkAllocateMemory;
+    PFN_vkFreeMemory freeMemory = vkFreeMemory;
+    PFN_vkMapMemory mapMemory = vkMapMemory;
+    PFN_vkUnmapMemory unmapMemory = vkUnmapMemory;
+    PFN_vkFlushMappedMemoryRanges flushMappedMemoryRanges = vkFlushMappedMemoryRanges;
+    PFN_vkInvalidateMappedMemoryRanges invalidateMappedMemoryRanges = vkInvalidateMappedMemoryRanges;
+};
+
+// Linear resources are buffers and linearly tiled images, optimal ones all other images. Both kinds are kept in
+// separate allocations so neither has to be padded to bufferImageGranularity
+enum class ResourceTiling
+{
+    Linear,
+    Optimal
+};
+
+enum class AllocationStrategy
+{
+    FreeList,
+    Tlsf,
+    Buddy
+};
+
+struct MemoryTypeStats
+{
+    VkDeviceSize reservedSize;     // Total size of device memory allocated for the type
+    VkDeviceSize allocatedSize;    // Bytes handed out including padding and rounding
+    VkDeviceSize wastedSize;       // Part of allocatedSize not requested, alignment padding and size rounding
+    VkDeviceSize largestFreeRange; // Largest request that fits without allocating device memory
+    float fragmentation;           // 1 - largestFreeRange / free bytes, 0 when all free memory is one range
+    uint32_t allocationCount;
+    uint32_t dedicatedCount;
+    uint64_t blockCount;    // Blocks allocated and not yet freed
+    uint64_t allocateCount; // Successful allocations since creation
+    uint64_t freeCount;
+    uint64_t allocateTime; // Nanoseconds spent in allocate since creation
+    uint64_t freeTime;
+};
+
+struct HeapStats
+{
+    MemoryTypeStats types; // Sum over the memory types of the heap, fragmentation over the largest range of any
+    VkDeviceSize budgetSize;
+    VkDeviceSize usage;
+};
+
 class MemoryAllocation : private NonCopyable
 {
 public:
-    bool allocate(const Device& device, VkDeviceSize size, uint32_t memoryTypeIndex);
+    // A dedicated buffer or image is passed on through VkMemoryDedicatedAllocateInfo
+    MemoryAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                     uint32_t memoryTypeIndex, VkBuffer dedicatedBuffer = VK_NULL_HANDLE,
+                     VkImage dedicatedImage = VK_NULL_HANDLE);
+    virtual ~MemoryAllocation();
 
-    MemoryAllocation(Device* device, VkDeviceSize size, uint32_t memoryTypeIndex);
-    ~MemoryAllocation();
+    virtual bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block) = 0;
+    virtual bool freeBlock(const MemoryBlock& block) = 0;
 
-    bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block);
-    bool freeBlock(const MemoryBlock& block);
+    virtual VkDeviceSize largestFreeRange() const = 0;
+    virtual size_t freeRangeCount() const = 0;
+    // Appends the used and free ranges covering the allocation in offset order, used ranges include their padding
+    virtual void ranges(std::vector<MemoryBlock>& ranges) const = 0;
+
+    virtual bool dedicated() const { return false; }
 
+    // Maps the whole allocation for its lifetime, blocks allocated afterwards carry their CPU address
+    bool map();
+
+    inline bool valid() const { return m_Memory != VK_NULL_HANDLE; }
+    inline void* mapped() const { return m_Ptr; }
     inline uint32_t memoryTypeIndex() const { return m_MemoryTypeIndex; }
     inline VkDeviceSize remainingSize() const { return m_Size - m_AllocatedSize; }
+    inline VkDeviceSize allocatedSize() const { return m_AllocatedSize; }
+    inline VkDeviceSize wastedSize() const { return m_WastedSize; }
     inline MemoryAllocation* next() const { return m_Next; }
     inline VkDeviceSize size() const { return m_Size; }
+    inline VkDeviceMemory memory() const { return m_Memory; }
+    inline ResourceTiling tiling() const { return m_Tiling; }
     void setNext(MemoryAllocation* next) { m_Next = next; }
+    void setTiling(ResourceTiling tiling) { m_Tiling = tiling; }
+
+protected:
+    MemoryBlock createBlock(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize padding, bool free) const;
+    inline void* mappedAt(VkDeviceSize offset) const { return m_Ptr ? static_cast<uint8_t*>(m_Ptr) + offset : nullptr; }
 
-private:
     VkDevice m_Device;
-    VkDeviceMemory m_Memory;
+    DeviceMemoryFunctions m_Functions;
+    VkDeviceMemory m_Memory = VK_NULL_HANDLE;
     VkDeviceSize m_Size;
     VkDeviceSize m_AllocatedSize = 0;
+    VkDeviceSize m_WastedSize = 0;
     uint32_t m_MemoryTypeIndex;
+    ResourceTiling m_Tiling = ResourceTiling::Linear;
 
     void* m_Ptr = nullptr;
 
-    std::vector<MemoryBlock> m_Blocks;
     MemoryAllocation* m_Next = nullptr;
 };
 
+// Best fit over free ranges indexed by size, neighbouring free ranges are merged on free
+class FreeListAllocation : public MemoryAllocation
+{
+public:
+    FreeListAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                       uint32_t memoryTypeIndex);
+
+    // O(log n) in the number of free ranges
+    virtual bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block) override;
+    virtual bool freeBlock(const MemoryBlock& block) override;
+
+    virtual VkDeviceSize largestFreeRange() const override;
+    virtual size_t freeRangeCount() const override { return m_FreeBlocks.size(); }
+    virtual void ranges(std::vector<MemoryBlock>& ranges) const override;
+
+private:
+    void insertFreeRange(VkDeviceSize start, VkDeviceSize size);
+    void removeFreeRange(VkDeviceSize start, VkDeviceSize size);
+
+    // All blocks keyed by the start of their range (offset - padding), used for merging neighbours
+    std::map<VkDeviceSize, MemoryBlock> m_Blocks;
+    // Free ranges keyed by size, value is range start
+    std::multimap<VkDeviceSize, VkDeviceSize> m_FreeBlocks;
+};
+
 struct Heap
 {
     VkDeviceSize size;
     VkDeviceSize budgetSize;
+    VkDeviceSize allocatedSize; // Device memory allocated from the heap by this allocator
+    // Rest of the process usage reported by VK_EXT_memory_budget, refreshed by updateBudget
+    VkDeviceSize externalUsage;
     VkMemoryHeapFlags flags;
+
+    inline VkDeviceSize usage() const { return allocatedSize + externalUsage; }
+};
+
+// Implemented by resource caches that can release resources when a heap runs over budget
+class MemoryBudgetHandler
+{
+public:
+    virtual ~MemoryBudgetHandler() = default;
+
+    // Release least recently used resources on the heap, requiredSize bytes if possible. Called from the thread that
+    // ran over budget, which may be any thread that allocates
+    virtual void evict(uint32_t heapIndex, VkDeviceSize requiredSize) = 0;
 };
 
+// allocate, free, allocateFor* and stats may be called from any thread. Memory types are locked separately
+// and each thread keeps a few recently freed small blocks to reuse without locking. update() and
+// releaseAllocation() belong to the render thread.
 class DeviceMemoryAllocator : private NonCopyable
 {
 public:
     DeviceMemoryAllocator(Device* device, VkDeviceSize size);
+    DeviceMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                          VkDeviceSize bufferImageGranularity, const DeviceMemoryFunctions& functions = {});
     ~DeviceMemoryAllocator();
 
-    bool allocate(VkDeviceSize size, VkDeviceSize allignment, uint32_t memoryTypeIndex, MemoryBlock& block);
+    bool allocate(VkDeviceSize size, VkDeviceSize allignment, uint32_t memoryTypeIndex, MemoryBlock& block,
+                  ResourceTiling tiling = ResourceTiling::Linear);
     void free(const MemoryBlock& block);
 
+    // Applies to allocations created for the memory type after the call
+    void setStrategy(uint32_t memoryTypeIndex, AllocationStrategy strategy);
+
+    // Allocations at or above the threshold get device memory of their own
+    void setDedicatedThreshold(VkDeviceSize threshold) { m_DedicatedThreshold = threshold; }
+
+    // Blocks already cached when disabled are returned on the next update
+    void setThreadCacheEnabled(bool enabled) { m_ThreadCacheEnabled = enabled; }
+
+    // Query the requirements of the resource and route it to a dedicated allocation when the driver
+    // prefers or requires one, or it is larger than the dedicated threshold. Lazily allocated is dropped from
+    // properties if no memory type of the resource has it
+    bool allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryBlock& block);
+    bool allocateForImage(VkImage image, VkMemoryPropertyFlags properties, MemoryBlock& block,
+                          ResourceTiling tiling = ResourceTiling::Optimal);
+    bool allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image,
+                           MemoryBlock& block);
+    // For memory shared by several resources, requirements combine theirs. buffer and image are only
+    // passed on to dedicated allocations
+    bool allocateForRequirements(const VkMemoryRequirements& requirements, bool dedicated,
+                                 VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image,
+                                 ResourceTiling tiling, MemoryBlock& block);
+
+    // Make host writes visible to the device and device writes visible to the host, no-ops for coherent memory.
+    // offset and size are relative to the block
+    bool flush(const MemoryBlock& block, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    bool invalidate(const MemoryBlock& block, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    // Allocate only from existing device memory of the type other than excluded, used to move buffers out of it
+    bool allocateExcluding(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                           const MemoryAllocation* excluded, MemoryBlock& block);
+    // Returns the device memory of an empty allocation to the driver
+    bool releaseAllocation(MemoryAllocation* allocation);
+    bool contains(const MemoryAllocation* allocation) const;
+
+    // Chain of allocations of the type, the mutex of the type must be held while walking it
+    inline MemoryAllocation* allocations(uint32_t memoryTypeIndex) const { return m_Allocations[memoryTypeIndex]; }
+    inline std::mutex& mutex(uint32_t memoryTypeIndex) const { return m_TypeMutexes[memoryTypeIndex]; }
+    inline uint32_t memoryTypeCount() const { return static_cast<uint32_t>(m_MemoryTypes.size()); }
+    inline uint32_t heapIndex(uint32_t memoryTypeIndex) const { return m_MemoryTypes[memoryTypeIndex].heapIndex; }
+
+    MemoryTypeStats stats(uint32_t memoryTypeIndex) const;
+    HeapStats heapStats(uint32_t heapIndex) const;
+
+    // Heaps and memory types with their stats and the ranges of every allocation, for offline inspection
+    std::string dumpJson() const;
+    // Blocks allocated and not freed yet, dedicated ones span their whole allocation. Blocks kept by thread caches
+    // count as allocated
+    std::vector<MemoryBlock> leakedBlocks() const;
+    inline const std::vector<Heap>& heaps() const { return m_MemoryHeaps; }
+
+    // Called once per frame, refreshes budgets and releases allocations that stayed empty for the release delay
+    void update();
+    // Refresh heap budgets and usage from VK_EXT_memory_budget
+    void updateBudget();
+
+    // Frames an allocation has to stay empty before its device memory is freed, 0 frees it on the next update.
+    // Memory emptied by an unload can be reused by the next load within the delay instead of being reallocated
+    void setReleaseDelay(uint32_t frames) { m_ReleaseDelay = frames; }
+
+    // Unregistering waits for the evictions the handler is running
+    void registerBudgetHandler(MemoryBudgetHandler* handler);
+    void unregisterBudgetHandler(MemoryBudgetHandler* handler);
+
     static bool findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags flags,
                                uint32_t& typeIndex);
 
-private:
-    MemoryAllocation* allocateNewMemory(VkDeviceSize size, uint32_t memoryTypeIndex);
-    MemoryAllocation* findSuitableAllocation(VkDeviceSize size, uint32_t memoryTypeIndex);
-
     static inline bool isPowerOfTwo(uint64_t num) { return (num & (num - 1)) == 0 && num != 0; };
     static uint64_t nextPowerOfTwo(uint64_t num);
 
+private:
+    struct ThreadCache;
+    struct OperationCounters
+    {
+        std::atomic<uint64_t> allocateCount = 0;
+        std::atomic<uint64_t> freeCount = 0;
+        std::atomic<uint64_t> allocateTime = 0;
+        std::atomic<uint64_t> freeTime = 0;
+    };
+
+    static ThreadCache& threadCache();
+    bool allocateFromCache(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex, ResourceTiling tiling,
+                           MemoryBlock& block);
+    bool cacheBlock(const MemoryBlock& block);
+    // Return the blocks of all thread caches to their allocations
+    void flushThreadCaches();
+    void releaseThreadCache(ThreadCache* cache);
+
+    bool suballocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex, ResourceTiling tiling,
+                     MemoryBlock& block);
+    bool createDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image,
+                         MemoryBlock& block);
+    bool freeBlock(const MemoryBlock& block);
+
+    // Logs blocks that were never freed, called on destruction
+    void reportLeaks() const;
+
+    // The mutex of the memory type of the block or allocation must be held
+    bool freeToAllocation(const MemoryBlock& block);
+    bool unlinkAllocation(MemoryAllocation* allocation);
+
+    MemoryAllocation* allocateNewMemory(VkDeviceSize size, uint32_t memoryTypeIndex, ResourceTiling tiling);
+    MemoryAllocation* createAllocation(VkDeviceSize size, uint32_t memoryTypeIndex);
+    void destroyAllocation(MemoryAllocation* allocation);
+    bool allocateFromExisting(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+                              ResourceTiling tiling, MemoryBlock& block, const MemoryAllocation* excluded = nullptr);
+    // Whether a resource may share the allocation without violating bufferImageGranularity
+    inline bool compatible(const MemoryAllocation* allocation, ResourceTiling tiling) const
+    {
+        return m_BufferImageGranularity <= 1 || allocation->tiling() == tiling;
+    }
+    void alignRequest(uint32_t memoryTypeIndex, VkDeviceSize& size, VkDeviceSize& alignment) const;
+
+    VkDeviceSize availableBudget(uint32_t heapIndex) const;
+    // Asks budget handlers to evict if size does not fit in the budget of the heap of the memory type
+    bool ensureBudget(uint32_t memoryTypeIndex, VkDeviceSize size);
+    bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags, uint32_t& typeIndex) const;
+
+    bool isHostVisible(uint32_t memoryTypeIndex) const;
+    bool isNonCoherent(uint32_t memoryTypeIndex) const;
+    // Expands the block range to nonCoherentAtomSize as required by flush and invalidate
+    VkMappedMemoryRange mappedRange(const MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) const;
+
     std::vector<MemoryAllocation*> m_Allocations;
-    Device* m_Device;
+    std::unordered_set<MemoryAllocation*> m_DedicatedAllocations;
+    // Per memory type, frames left until the allocation is released
+    std::vector<std::unordered_map<MemoryAllocation*, uint32_t>> m_EmptyAllocations;
+    std::vector<AllocationStrategy> m_Strategies;
+    std::vector<MemoryBudgetHandler*> m_BudgetHandlers;
+    VkDevice m_Device;
+    VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+    bool m_BudgetSupported = false;
+    DeviceMemoryFunctions m_Functions;
     VkDeviceSize m_Size;
     VkPhysicalDeviceMemoryProperties m_MemoryProperties;
 
     std::vector<VkMemoryType> m_MemoryTypes;
     std::vector<Heap> m_MemoryHeaps;
 
-    VkDeviceSize m_PageSize;
+    mutable std::array<std::mutex, VK_MAX_MEMORY_TYPES> m_TypeMutexes;
+    mutable std::mutex m_HeapMutex;      // Heap usage and budgets
+    mutable std::mutex m_DedicatedMutex; // m_DedicatedAllocations
+    std::mutex m_BudgetHandlerMutex;     // m_BudgetHandlers, held while the handlers evict
+    std::mutex m_CacheMutex;             // m_ThreadCaches
+    std::unordered_set<ThreadCache*> m_ThreadCaches;
+
+    std::array<OperationCounters, VK_MAX_MEMORY_TYPES> m_Counters;
+
+    VkDeviceSize m_BufferImageGranularity;
     VkDeviceSize m_MinimumAllocationSize;
+    VkDeviceSize m_DedicatedThreshold = DEFAULT_DEDICATED_THRESHOLD;
+    VkDeviceSize m_NonCoherentAtomSize = 1;
+    uint32_t m_ReleaseDelay = DEFAULT_RELEASE_DELAY;
+    std::atomic<bool> m_ThreadCacheEnabled = true;
+
+    static constexpr VkDeviceSize DEFAULT_DEDICATED_THRESHOLD = 32 * 1024 * 1024;
+    static constexpr VkDeviceSize MINIMUM_ALLOCATION_SIZE = 1024 * 1024;
+    static constexpr uint32_t DEFAULT_RELEASE_DELAY = 300;
+    static constexpr size_t THREAD_CACHE_SIZE = 16;
+    static constexpr VkDeviceSize THREAD_CACHE_MAX_BLOCK_SIZE = 64 * 1024;
 };
 }; // namespace vrender
@@ -0,0 +1,57 @@
+#include "staging_ring.hpp"
+
+namespace vrender
+{
+
+StagingRing::StagingRing(VkDeviceSize size, VkDeviceSize alignment) : m_Size(size), m_Alignment(alignment) {}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& reserved)
+{
+    size = ((size + m_Alignment - 1) / m_Alignment) * m_Alignment;
+    if (m_Used == 0)
+        m_Head = m_Tail = 0;
+
+    // Free space is [head, end) and [0, tail) while the head is ahead of the tail, [head, tail) once it wrapped
+    VkDeviceSize skipped = 0;
+    if (m_Head > m_Tail || m_Used == 0)
+    {
+        if (m_Head + size <= m_Size)
+        {
+            offset = m_Head;
+        }
+        else if (size <= m_Tail)
+        {
+            skipped = m_Size - m_Head;
+            offset = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (m_Head < m_Tail && m_Head + size <= m_Tail)
+    {
+        offset = m_Head;
+    }
+    else
+    {
+        return false;
+    }
+
+    m_Head = offset + size;
+    m_Used += skipped + size;
+    reserved = skipped + size;
+    return true;
+}
+
+void StagingRing::release(VkDeviceSize reserved)
+{
+    if (reserved == 0)
+        return;
+
+    // Reservations are contiguous in allocation order, skipped bytes included, so the tail moves by their size
+    m_Used -= reserved;
+    m_Tail = (m_Tail + reserved) % m_Size;
+}
+
+}; // namespace vrender
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+namespace vrender
+{
+
+// Offsets into a ring of staging memory. Ranges are handed out at the head and returned in the order they were
+// allocated, so the tail only needs the size of the oldest reservation. A range that does not fit before the end of
+// the ring starts over at 0, the bytes skipped at the end count towards the reservation that wrapped.
+class StagingRing
+{
+public:
+    StagingRing(VkDeviceSize size, VkDeviceSize alignment);
+
+    // Returns false if the size does not fit in the free space. reserved is the number of bytes taken from the ring
+    // including any skipped at the wrap, it has to be released again
+    bool allocate(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& reserved);
+    // Returns the oldest reserved bytes
+    void release(VkDeviceSize reserved);
+
+    inline VkDeviceSize size() const { return m_Size; }
+    inline VkDeviceSize usedSize() const { return m_Used; }
+    inline VkDeviceSize head() const { return m_Head; }
+    inline VkDeviceSize tail() const { return m_Tail; }
+
+private:
+    VkDeviceSize m_Size;
+    VkDeviceSize m_Alignment;
+    VkDeviceSize m_Head = 0;
+    VkDeviceSize m_Tail = 0;
+    VkDeviceSize m_Used = 0;
+};
+
+}; // namespace vrender
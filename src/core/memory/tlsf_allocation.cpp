@@ -0,0 +1,296 @@
+#include "tlsf_allocation.hpp"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vrender
+{
+
+static inline uint32_t findLastSet(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+static inline uint32_t findFirstSet(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+TlsfAllocation::TlsfAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                               uint32_t memoryTypeIndex)
+    : MemoryAllocation(device, functions, size, memoryTypeIndex)
+{
+    for (uint32_t fl = 0; fl < FL_INDEX_COUNT; fl++)
+        std::fill(std::begin(m_FreeHeads[fl]), std::end(m_FreeHeads[fl]), NONE);
+
+    if (!valid())
+        return;
+
+    uint32_t index = createNode();
+    m_Nodes[index].offset = 0;
+    m_Nodes[index].size = size;
+    insertFree(index);
+}
+
+void TlsfAllocation::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        // Small sizes get a linear bucket per byte count
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+
+    uint32_t bit = findLastSet(size);
+    sl = static_cast<uint32_t>(size >> (bit - SL_INDEX_LOG2)) ^ SL_INDEX_COUNT;
+    fl = bit - FL_INDEX_SHIFT + 1;
+}
+
+void TlsfAllocation::mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    // Round up to the next second level bucket so every range found is large enough
+    if (size >= SMALL_BLOCK_SIZE)
+        size += (VkDeviceSize(1) << (findLastSet(size) - SL_INDEX_LOG2)) - 1;
+    mapping(size, fl, sl);
+}
+
+uint32_t TlsfAllocation::findFree(uint32_t& fl, uint32_t& sl) const
+{
+    if (fl >= FL_INDEX_COUNT)
+        return NONE;
+
+    uint32_t slMap = m_SlBitmap[fl] & (~0u << sl);
+    if (!slMap)
+    {
+        uint64_t flMap = m_FlBitmap & (~uint64_t(0) << (fl + 1));
+        if (!flMap)
+            return NONE;
+
+        fl = findFirstSet(flMap);
+        slMap = m_SlBitmap[fl];
+    }
+    sl = findFirstSet(slMap);
+    return m_FreeHeads[fl][sl];
+}
+
+uint32_t TlsfAllocation::findFit(VkDeviceSize size, VkDeviceSize alignment, uint32_t searchFl,
+                                 uint32_t searchSl) const
+{
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+    while (fl < FL_INDEX_COUNT && (fl < searchFl || (fl == searchFl && sl < searchSl)))
+    {
+        for (uint32_t index = m_FreeHeads[fl][sl]; index != NONE; index = m_Nodes[index].nextFree)
+        {
+            const Node& node = m_Nodes[index];
+            if (node.size >= (alignment - node.offset % alignment) % alignment + size)
+                return index;
+        }
+
+        if (++sl == SL_INDEX_COUNT)
+        {
+            sl = 0;
+            fl++;
+        }
+    }
+    return NONE;
+}
+
+void TlsfAllocation::insertFree(uint32_t index)
+{
+    uint32_t fl, sl;
+    mapping(m_Nodes[index].size, fl, sl);
+
+    Node& node = m_Nodes[index];
+    node.free = true;
+    node.prevFree = NONE;
+    node.nextFree = m_FreeHeads[fl][sl];
+    if (node.nextFree != NONE)
+        m_Nodes[node.nextFree].prevFree = index;
+    m_FreeHeads[fl][sl] = index;
+
+    m_FlBitmap |= uint64_t(1) << fl;
+    m_SlBitmap[fl] |= 1u << sl;
+    m_FreeCount++;
+}
+
+void TlsfAllocation::removeFree(uint32_t index)
+{
+    uint32_t fl, sl;
+    mapping(m_Nodes[index].size, fl, sl);
+
+    Node& node = m_Nodes[index];
+    if (node.prevFree != NONE)
+        m_Nodes[node.prevFree].nextFree = node.nextFree;
+    if (node.nextFree != NONE)
+        m_Nodes[node.nextFree].prevFree = node.prevFree;
+
+    if (m_FreeHeads[fl][sl] == index)
+    {
+        m_FreeHeads[fl][sl] = node.nextFree;
+        if (node.nextFree == NONE)
+        {
+            m_SlBitmap[fl] &= ~(1u << sl);
+            if (!m_SlBitmap[fl])
+                m_FlBitmap &= ~(uint64_t(1) << fl);
+        }
+    }
+
+    node.free = false;
+    node.prevFree = NONE;
+    node.nextFree = NONE;
+    m_FreeCount--;
+}
+
+uint32_t TlsfAllocation::createNode()
+{
+    uint32_t index;
+    if (!m_UnusedNodes.empty())
+    {
+        index = m_UnusedNodes.back();
+        m_UnusedNodes.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(m_Nodes.size());
+        m_Nodes.emplace_back();
+    }
+    m_Nodes[index] = {0, 0, NONE, NONE, NONE, NONE, false};
+    return index;
+}
+
+void TlsfAllocation::releaseNode(uint32_t index)
+{
+    m_UnusedNodes.push_back(index);
+}
+
+bool TlsfAllocation::allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block)
+{
+    if (size == 0 || size > remainingSize())
+        return false;
+    if (alignment == 0)
+        alignment = 1;
+
+    uint32_t fl, sl;
+    mappingSearch(size + alignment - 1, fl, sl);
+    uint32_t searchFl = fl, searchSl = sl;
+    uint32_t index = findFree(fl, sl);
+    // The rounded search skips ranges that only fit with less than the worst case padding, checked before giving up
+    if (index == NONE)
+        index = findFit(size, alignment, searchFl, searchSl);
+    if (index == NONE)
+        return false;
+
+    removeFree(index);
+
+    VkDeviceSize padding = (alignment - (m_Nodes[index].offset % alignment)) % alignment;
+    VkDeviceSize used = padding + size;
+    VkDeviceSize remaining = m_Nodes[index].size - used;
+
+    // Slivers too small to be useful stay with the block and are returned with it
+    if (remaining >= MIN_SPLIT_SIZE)
+    {
+        uint32_t split = createNode();
+        Node& node = m_Nodes[index];
+        Node& splitNode = m_Nodes[split];
+
+        splitNode.offset = node.offset + used;
+        splitNode.size = remaining;
+        splitNode.prevPhysical = index;
+        splitNode.nextPhysical = node.nextPhysical;
+        if (node.nextPhysical != NONE)
+            m_Nodes[node.nextPhysical].prevPhysical = split;
+
+        node.nextPhysical = split;
+        node.size = used;
+        insertFree(split);
+    }
+
+    const Node& node = m_Nodes[index];
+    m_UsedNodes[node.offset] = index;
+    m_AllocatedSize += node.size;
+    m_WastedSize += node.size - size;
+
+    block = createBlock(node.offset + padding, size, padding, false);
+    return true;
+}
+
+bool TlsfAllocation::freeBlock(const MemoryBlock& block)
+{
+    auto it = m_UsedNodes.find(block.offset - block.padding);
+    if (it == m_UsedNodes.end())
+        return false;
+
+    uint32_t index = it->second;
+    m_UsedNodes.erase(it);
+    m_AllocatedSize -= m_Nodes[index].size;
+    m_WastedSize -= m_Nodes[index].size - block.size;
+
+    uint32_t next = m_Nodes[index].nextPhysical;
+    if (next != NONE && m_Nodes[next].free)
+    {
+        removeFree(next);
+        m_Nodes[index].size += m_Nodes[next].size;
+        m_Nodes[index].nextPhysical = m_Nodes[next].nextPhysical;
+        if (m_Nodes[next].nextPhysical != NONE)
+            m_Nodes[m_Nodes[next].nextPhysical].prevPhysical = index;
+        releaseNode(next);
+    }
+
+    uint32_t prev = m_Nodes[index].prevPhysical;
+    if (prev != NONE && m_Nodes[prev].free)
+    {
+        removeFree(prev);
+        m_Nodes[prev].size += m_Nodes[index].size;
+        m_Nodes[prev].nextPhysical = m_Nodes[index].nextPhysical;
+        if (m_Nodes[index].nextPhysical != NONE)
+            m_Nodes[m_Nodes[index].nextPhysical].prevPhysical = prev;
+        releaseNode(index);
+        index = prev;
+    }
+
+    insertFree(index);
+    return true;
+}
+
+void TlsfAllocation::ranges(std::vector<MemoryBlock>& ranges) const
+{
+    if (!valid())
+        return;
+
+    // The node at offset 0 is created first and is never merged into a previous node
+    for (uint32_t index = 0; index != NONE; index = m_Nodes[index].nextPhysical)
+        ranges.push_back(createBlock(m_Nodes[index].offset, m_Nodes[index].size, 0, m_Nodes[index].free));
+}
+
+VkDeviceSize TlsfAllocation::largestFreeRange() const
+{
+    if (!m_FlBitmap)
+        return 0;
+
+    uint32_t fl = findLastSet(m_FlBitmap);
+    uint32_t sl = findLastSet(m_SlBitmap[fl]);
+
+    VkDeviceSize largest = 0;
+    for (uint32_t index = m_FreeHeads[fl][sl]; index != NONE; index = m_Nodes[index].nextFree)
+        largest = std::max(largest, m_Nodes[index].size);
+    return largest;
+}
+
+}; // namespace vrender
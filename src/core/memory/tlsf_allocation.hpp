@@ -0,0 +1,73 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vrender
+{
+
+// Two-level segregated fit, constant time allocate and free. Free ranges are bucketed by the
+// position of their highest bit (first level) and subdivided linearly within it (second level),
+// with bitmaps to find the first non-empty bucket large enough for a request.
+class TlsfAllocation : public MemoryAllocation
+{
+public:
+    TlsfAllocation(VkDevice device, const DeviceMemoryFunctions& functions, VkDeviceSize size,
+                   uint32_t memoryTypeIndex);
+
+    virtual bool allocateBlock(VkDeviceSize size, VkDeviceSize alignment, MemoryBlock& block) override;
+    virtual bool freeBlock(const MemoryBlock& block) override;
+
+    virtual VkDeviceSize largestFreeRange() const override;
+    virtual size_t freeRangeCount() const override { return m_FreeCount; }
+    virtual void ranges(std::vector<MemoryBlock>& ranges) const override;
+
+private:
+    static constexpr uint32_t SL_INDEX_LOG2 = 5;
+    static constexpr uint32_t SL_INDEX_COUNT = 1 << SL_INDEX_LOG2;
+    static constexpr uint32_t FL_INDEX_SHIFT = SL_INDEX_LOG2;
+    static constexpr uint32_t FL_INDEX_COUNT = 64 - FL_INDEX_SHIFT + 1;
+    static constexpr VkDeviceSize SMALL_BLOCK_SIZE = VkDeviceSize(1) << FL_INDEX_SHIFT;
+    static constexpr VkDeviceSize MIN_SPLIT_SIZE = 16;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+
+        bool free;
+    };
+
+    static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+    static void mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+    uint32_t findFree(uint32_t& fl, uint32_t& sl) const;
+    // Walks the buckets below the rounded search that may still hold a range large enough
+    uint32_t findFit(VkDeviceSize size, VkDeviceSize alignment, uint32_t searchFl, uint32_t searchSl) const;
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+
+    uint32_t createNode();
+    void releaseNode(uint32_t node);
+
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_UnusedNodes;
+    // Used nodes keyed by the start of their range (offset - padding)
+    std::unordered_map<VkDeviceSize, uint32_t> m_UsedNodes;
+
+    uint64_t m_FlBitmap = 0;
+    uint32_t m_SlBitmap[FL_INDEX_COUNT] = {};
+    uint32_t m_FreeHeads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    size_t m_FreeCount = 0;
+};
+
+}; // namespace vrender
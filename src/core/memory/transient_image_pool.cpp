@@ -0,0 +1,164 @@
+#include "transient_image_pool.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+namespace vrender
+{
+
+TransientImagePool::TransientImagePool(DeviceMemoryAllocator* allocator) : m_Allocator(allocator)
+{
+}
+
+TransientImagePool::~TransientImagePool()
+{
+    release();
+}
+
+uint32_t TransientImagePool::declare(const ImageInfo& info, uint32_t firstUse, uint32_t lastUse)
+{
+    if (info.tiling != VK_IMAGE_TILING_OPTIMAL)
+        V_LOG_ERROR("Transient images must use optimal tiling.");
+
+    Entry entry = {};
+    entry.info = info;
+    entry.range.firstUse = std::min(firstUse, lastUse);
+    entry.range.lastUse = std::max(firstUse, lastUse);
+    m_Images.push_back(std::move(entry));
+    return static_cast<uint32_t>(m_Images.size() - 1);
+}
+
+bool TransientImagePool::build()
+{
+    release();
+    if (m_Images.empty())
+        return true;
+
+    VkMemoryRequirements requirements = {};
+    requirements.alignment = 1;
+    requirements.memoryTypeBits = ~0u;
+    bool transient = true;
+    m_RequiredSize = 0;
+
+    std::vector<TransientRange*> ranges;
+    for (Entry& entry : m_Images)
+    {
+        entry.image = std::make_unique<Image>(entry.info, false);
+        if (entry.image->image() == VK_NULL_HANDLE)
+        {
+            release();
+            return false;
+        }
+
+        VkMemoryRequirements imageRequirements = entry.image->memoryRequirements();
+        requirements.alignment = std::max(requirements.alignment, imageRequirements.alignment);
+        requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+        transient &= entry.info.transient;
+        entry.range.size = imageRequirements.size;
+        entry.range.alignment = imageRequirements.alignment;
+        ranges.push_back(&entry.range);
+    }
+
+    if (requirements.memoryTypeBits == 0)
+    {
+        V_LOG_ERROR("Transient images have no memory type in common.");
+        release();
+        return false;
+    }
+
+    m_Size = place(ranges, m_RequiredSize);
+    requirements.size = m_Size;
+
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (transient)
+        properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    if (!m_Allocator->allocateForRequirements(requirements, false, properties, VK_NULL_HANDLE, VK_NULL_HANDLE,
+                                              ResourceTiling::Optimal, m_Memory))
+    {
+        release();
+        return false;
+    }
+
+    for (Entry& entry : m_Images)
+    {
+        if (!entry.image->bindMemory(m_Memory, entry.range.offset))
+        {
+            V_LOG_ERROR("Failed to bind transient image memory.");
+            release();
+            return false;
+        }
+    }
+
+    V_LOG_DEBUG("Transient images use {} of {} bytes.", m_Size, m_RequiredSize);
+    return true;
+}
+
+void TransientImagePool::clear()
+{
+    release();
+    m_Images.clear();
+    m_RequiredSize = 0;
+}
+
+VkDeviceSize TransientImagePool::place(const std::vector<TransientRange*>& ranges, VkDeviceSize& requiredSize)
+{
+    // Largest first keeps small images from splitting the ranges large ones could share
+    std::vector<TransientRange*> sorted = ranges;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const TransientRange* a, const TransientRange* b) { return a->size > b->size; });
+
+    // Every offset found is at most the aligned end of everything placed before, so the aliased ranges never span
+    // more than the same ranges without aliasing
+    VkDeviceSize size = 0;
+    requiredSize = 0;
+    std::vector<const TransientRange*> placed;
+    for (TransientRange* range : sorted)
+    {
+        requiredSize = ((requiredSize + range->alignment - 1) / range->alignment) * range->alignment + range->size;
+        range->offset = findOffset(*range, placed);
+        size = std::max(size, range->offset + range->size);
+        placed.push_back(range);
+    }
+    return size;
+}
+
+VkDeviceSize TransientImagePool::findOffset(const TransientRange& range,
+                                            const std::vector<const TransientRange*>& placed)
+{
+    std::vector<const TransientRange*> live;
+    for (const TransientRange* other : placed)
+    {
+        if (other->firstUse <= range.lastUse && range.firstUse <= other->lastUse)
+            live.push_back(other);
+    }
+    std::sort(live.begin(), live.end(),
+              [](const TransientRange* a, const TransientRange* b) { return a->offset < b->offset; });
+
+    VkDeviceSize alignment = range.alignment;
+    VkDeviceSize offset = 0;
+    for (const TransientRange* other : live)
+    {
+        if (offset + range.size <= other->offset)
+            break;
+
+        VkDeviceSize end = other->offset + other->size;
+        if (end > offset)
+            offset = ((end + alignment - 1) / alignment) * alignment;
+    }
+    return offset;
+}
+
+void TransientImagePool::release()
+{
+    // Destroy the images before freeing the memory they are bound to
+    for (Entry& entry : m_Images)
+        entry.image.reset();
+
+    if (m_Memory.allocation)
+        m_Allocator->free(m_Memory);
+    m_Memory = {};
+    m_Size = 0;
+}
+
+}; // namespace vrender
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+#include "core/vulkan/image.hpp"
+#include "utils/noncopyable.hpp"
+
+#include "vulkan/vulkan.h"
+
+#include <memory>
+#include <vector>
+
+namespace vrender
+{
+
+// Memory range of a transient image used from pass firstUse to pass lastUse, offset is assigned by placement
+struct TransientRange
+{
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    uint32_t firstUse;
+    uint32_t lastUse;
+    VkDeviceSize offset;
+};
+
+// Places render targets that only live for part of a frame in one memory block, images whose uses do not
+// overlap share the same range. Uses are pass indices within the frame. An image's contents are undefined at
+// its first use, which has to start from VK_IMAGE_LAYOUT_UNDEFINED after a barrier on the previous user of the
+// range.
+class TransientImagePool : private NonCopyable
+{
+public:
+    TransientImagePool(DeviceMemoryAllocator* allocator);
+    ~TransientImagePool();
+
+    // Returns the index of the image in the pool, only valid for optimal tiling
+    uint32_t declare(const ImageInfo& info, uint32_t firstUse, uint32_t lastUse);
+    // Creates all declared images and binds them, destroying the ones of a previous build
+    bool build();
+    // Destroys images, memory and declarations, e.g. before declaring the targets again for a new extent.
+    // The images must no longer be in use by the device
+    void clear();
+
+    inline Image* image(uint32_t index) const { return m_Images[index].image.get(); }
+    // Bytes bound, compared to requiredSize without aliasing
+    inline VkDeviceSize size() const { return m_Size; }
+    inline VkDeviceSize requiredSize() const { return m_RequiredSize; }
+
+    // Assigns every range an offset where it does not overlap a range used at the same time, returns the bytes
+    // spanned by all of them. requiredSize is what they would span placed one after another without aliasing
+    static VkDeviceSize place(const std::vector<TransientRange*>& ranges, VkDeviceSize& requiredSize);
+
+private:
+    struct Entry
+    {
+        ImageInfo info;
+        std::unique_ptr<Image> image;
+        TransientRange range;
+    };
+
+    // Lowest offset at which the range does not overlap a placed range used at the same time
+    static VkDeviceSize findOffset(const TransientRange& range, const std::vector<const TransientRange*>& placed);
+    void release();
+
+    DeviceMemoryAllocator* m_Allocator;
+
+    std::vector<Entry> m_Images;
+    MemoryBlock m_Memory = {};
+    VkDeviceSize m_Size = 0;
+    VkDeviceSize m_RequiredSize = 0;
+};
+
+}; // namespace vrender
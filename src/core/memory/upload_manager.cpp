@@ -0,0 +1,520 @@
+#include "upload_manager.hpp"
+#include "utils/log.hpp"
+
+#include <cstring>
+
+namespace vrender
+{
+
+UploadManager::UploadManager(Device* device, DeviceMemoryAllocator* allocator, VkDeviceSize stagingSize)
+    : m_Device(device), m_Allocator(allocator), m_StagingSize(stagingSize), m_Ring(stagingSize, STAGING_ALIGNMENT)
+{
+    QueueFamilyIndices families = m_Device->queueFamilyIndices();
+    m_GraphicsFamily = families.graphicsFamily.value();
+    m_TransferFamily = m_GraphicsFamily;
+    m_Queue = m_Device->graphicsQueue();
+    if (m_Device->hasTransferQueue() && families.transferFamily.has_value())
+    {
+        m_TransferFamily = families.transferFamily.value();
+        m_Queue = m_Device->transferQueue();
+    }
+
+    if (!createBatches())
+        V_LOG_ERROR("Unable to create upload command buffers.");
+
+    // Uploads still work through staging buffers of their own without the ring
+    if (!createStagingRing())
+    {
+        V_LOG_ERROR("Unable to create upload staging buffer.");
+        m_StagingSize = 0;
+        m_StagingData = nullptr;
+    }
+}
+
+UploadManager::~UploadManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        submit();
+        retire(m_NextTicket, true);
+    }
+
+    for (Batch& batch : m_Batches)
+    {
+        vkDestroyFence(m_Device->device(), batch.fence, nullptr);
+        vkDestroyFence(m_Device->device(), batch.acquireFence, nullptr);
+        vkDestroySemaphore(m_Device->device(), batch.semaphore, nullptr);
+    }
+    vkDestroyCommandPool(m_Device->device(), m_CommandPool, nullptr);
+    vkDestroyCommandPool(m_Device->device(), m_AcquireCommandPool, nullptr);
+
+    vkDestroyBuffer(m_Device->device(), m_StagingBuffer, nullptr);
+    if (m_StagingMemory.allocation)
+        m_Allocator->free(m_StagingMemory);
+}
+
+bool UploadManager::createStagingRing()
+{
+    VkBufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = m_StagingSize;
+    createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_Device->device(), &createInfo, nullptr, &m_StagingBuffer) != VK_SUCCESS)
+        return false;
+
+    if (!m_Allocator->allocateForBuffer(m_StagingBuffer,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        m_StagingMemory))
+        return false;
+
+    vkBindBufferMemory(m_Device->device(), m_StagingBuffer, m_StagingMemory.memory, m_StagingMemory.offset);
+    m_StagingData = static_cast<uint8_t*>(m_StagingMemory.mapped);
+
+    return m_StagingData != nullptr;
+}
+
+bool UploadManager::createBatches()
+{
+    // A pool of its own, the device pool is recorded into by the render thread
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_TransferFamily;
+
+    if (vkCreateCommandPool(m_Device->device(), &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS)
+        return false;
+
+    std::vector<VkCommandBuffer> commandBuffers(BATCH_COUNT);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = BATCH_COUNT;
+    allocInfo.commandPool = m_CommandPool;
+
+    if (vkAllocateCommandBuffers(m_Device->device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        return false;
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    m_Batches.resize(BATCH_COUNT);
+    for (uint32_t i = 0; i < BATCH_COUNT; i++)
+    {
+        m_Batches[i].commandBuffer = commandBuffers[i];
+        if (vkCreateFence(m_Device->device(), &fenceInfo, nullptr, &m_Batches[i].fence) != VK_SUCCESS)
+            return false;
+        m_FreeBatches.push_back(&m_Batches[i]);
+    }
+    return !usesTransferQueue() || createAcquireBatches();
+}
+
+bool UploadManager::createAcquireBatches()
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_GraphicsFamily;
+
+    if (vkCreateCommandPool(m_Device->device(), &poolInfo, nullptr, &m_AcquireCommandPool) != VK_SUCCESS)
+        return false;
+
+    std::vector<VkCommandBuffer> commandBuffers(BATCH_COUNT);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = BATCH_COUNT;
+    allocInfo.commandPool = m_AcquireCommandPool;
+
+    if (vkAllocateCommandBuffers(m_Device->device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        return false;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (uint32_t i = 0; i < BATCH_COUNT; i++)
+    {
+        m_Batches[i].acquireCommandBuffer = commandBuffers[i];
+        if (vkCreateSemaphore(m_Device->device(), &semaphoreInfo, nullptr, &m_Batches[i].semaphore) != VK_SUCCESS)
+            return false;
+        if (vkCreateFence(m_Device->device(), &fenceInfo, nullptr, &m_Batches[i].acquireFence) != VK_SUCCESS)
+            return false;
+    }
+    return true;
+}
+
+uint64_t UploadManager::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    if (size == 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Batch* batch = recordingBatch();
+    VkBuffer srcBuffer;
+    VkDeviceSize srcOffset;
+    if (!batch || !stage(data, size, batch, srcBuffer, srcOffset))
+        return 0;
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(batch->commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+    if (usesTransferQueue())
+    {
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        barrier.srcQueueFamilyIndex = m_TransferFamily;
+        barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+        barrier.buffer = dstBuffer;
+        barrier.offset = dstOffset;
+        barrier.size = size;
+        batch->bufferBarriers.push_back(barrier);
+    }
+
+    return batch->ticket;
+}
+
+uint64_t UploadManager::uploadImage(VkImage dstImage, VkImageAspectFlags aspect, VkExtent3D extent, const void* data,
+                                    VkDeviceSize size, VkImageLayout finalLayout)
+{
+    if (size == 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Batch* batch = recordingBatch();
+    VkBuffer srcBuffer;
+    VkDeviceSize srcOffset;
+    if (!batch || !stage(data, size, batch, srcBuffer, srcOffset))
+        return 0;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.image = dstImage;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &barrier);
+
+    // Whole mip levels always meet the image transfer granularity of transfer only families
+    VkBufferImageCopy region = {};
+    region.bufferOffset = srcOffset;
+    region.imageSubresource.aspectMask = aspect;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(batch->commandBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &region);
+
+    // The transition to the final layout is recorded with the release, and repeated by the acquire
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    if (usesTransferQueue())
+    {
+        barrier.srcQueueFamilyIndex = m_TransferFamily;
+        barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+    }
+    batch->imageBarriers.push_back(barrier);
+
+    return batch->ticket;
+}
+
+void UploadManager::flush()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    submit();
+}
+
+bool UploadManager::isComplete(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (ticket > m_CompletedTicket)
+        retire(ticket, false);
+    return ticket <= m_CompletedTicket && m_FailedTickets.count(ticket) == 0;
+}
+
+bool UploadManager::isFailed(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (ticket > m_CompletedTicket)
+        retire(ticket, false);
+    return m_FailedTickets.count(ticket) != 0;
+}
+
+void UploadManager::wait(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (ticket <= m_CompletedTicket)
+        return;
+
+    if (m_Recording && m_Recording->ticket <= ticket)
+        submit();
+    retire(ticket, true);
+}
+
+void UploadManager::update()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    submit();
+    retire(m_NextTicket, false);
+}
+
+UploadManager::Batch* UploadManager::recordingBatch()
+{
+    if (m_Recording)
+        return m_Recording;
+
+    if (m_FreeBatches.empty() && !m_SubmittedBatches.empty())
+        retire(m_SubmittedBatches.front()->ticket, true);
+    if (m_FreeBatches.empty())
+        return nullptr;
+
+    Batch* batch = m_FreeBatches.back();
+    m_FreeBatches.pop_back();
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch->commandBuffer, &beginInfo);
+
+    batch->ticket = m_NextTicket++;
+    batch->ringSize = 0;
+    batch->copiesSubmitted = false;
+    batch->acquireSubmitted = false;
+    m_Recording = batch;
+    return batch;
+}
+
+bool UploadManager::stage(const void* data, VkDeviceSize size, Batch*& batch, VkBuffer& srcBuffer,
+                          VkDeviceSize& srcOffset)
+{
+    if (m_StagingData && size <= m_StagingSize)
+    {
+        // Make room in the ring by submitting what is recorded and waiting on the oldest batch
+        bool staged = allocateStaging(size, srcOffset);
+        while (!staged && (batch->ringSize > 0 || !m_SubmittedBatches.empty()))
+        {
+            if (batch->ringSize > 0)
+                submit();
+            retire(m_SubmittedBatches.front()->ticket, true);
+            if (!(batch = recordingBatch()))
+                return false;
+            staged = allocateStaging(size, srcOffset);
+        }
+
+        if (staged)
+        {
+            memcpy(m_StagingData + srcOffset, data, static_cast<size_t>(size));
+            srcBuffer = m_StagingBuffer;
+            return true;
+        }
+    }
+
+    StagingBuffer staging;
+    if (!createStagingBuffer(data, size, staging))
+        return false;
+    batch->stagingBuffers.push_back(staging);
+    srcBuffer = staging.buffer;
+    srcOffset = 0;
+    return true;
+}
+
+void UploadManager::submit()
+{
+    Batch* batch = m_Recording;
+    if (!batch)
+        return;
+    m_Recording = nullptr;
+
+    if (usesTransferQueue())
+    {
+        // Release to the graphics family, the graphics queue has to acquire before the resources are used
+        vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(batch->bufferBarriers.size()),
+                             batch->bufferBarriers.data(), static_cast<uint32_t>(batch->imageBarriers.size()),
+                             batch->imageBarriers.data());
+    }
+    else
+    {
+        // Make the copies visible to whatever is submitted to the queue after the batch
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 1, &barrier, 0, nullptr, static_cast<uint32_t>(batch->imageBarriers.size()),
+                             batch->imageBarriers.data());
+    }
+    vkEndCommandBuffer(batch->commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->commandBuffer;
+
+    if (usesTransferQueue())
+    {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch->semaphore;
+    }
+
+    vkResetFences(m_Device->device(), 1, &batch->fence);
+    batch->copiesSubmitted = m_Device->submit(m_Queue, 1, &submitInfo, batch->fence) == VK_SUCCESS;
+    if (batch->copiesSubmitted && usesTransferQueue())
+        batch->acquireSubmitted = submitAcquire(batch);
+    if (!batch->copiesSubmitted || (usesTransferQueue() && !batch->acquireSubmitted))
+        V_LOG_ERROR("Unable to submit uploads.");
+
+    batch->bufferBarriers.clear();
+    batch->imageBarriers.clear();
+    m_SubmittedBatches.push_back(batch);
+    m_SubmitCount++;
+}
+
+bool UploadManager::submitAcquire(Batch* batch)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch->acquireCommandBuffer, &beginInfo);
+
+    // Same barriers as the release, the semaphore orders them after the copies
+    vkCmdPipelineBarrier(batch->acquireCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(batch->bufferBarriers.size()), batch->bufferBarriers.data(),
+                         static_cast<uint32_t>(batch->imageBarriers.size()), batch->imageBarriers.data());
+    vkEndCommandBuffer(batch->acquireCommandBuffer);
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &batch->semaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->acquireCommandBuffer;
+
+    vkResetFences(m_Device->device(), 1, &batch->acquireFence);
+    return m_Device->submit(m_Device->graphicsQueue(), 1, &submitInfo, batch->acquireFence) == VK_SUCCESS;
+}
+
+void UploadManager::retire(uint64_t ticket, bool wait)
+{
+    while (!m_SubmittedBatches.empty() && m_SubmittedBatches.front()->ticket <= ticket)
+    {
+        Batch* batch = m_SubmittedBatches.front();
+
+        // Nothing of the batch is recycled before every submit that went through has executed, the copies may
+        // still be running when only the acquire failed
+        uint32_t fenceCount = 0;
+        VkFence fences[2];
+        if (batch->copiesSubmitted)
+            fences[fenceCount++] = batch->fence;
+        if (batch->acquireSubmitted)
+            fences[fenceCount++] = batch->acquireFence;
+        if (fenceCount > 0)
+        {
+            VkResult result = vkWaitForFences(m_Device->device(), fenceCount, fences, VK_TRUE, wait ? UINT64_MAX : 0);
+            if (!wait && result != VK_SUCCESS)
+                break;
+        }
+
+        // The uploads of the batch never reached the graphics queue, their destinations hold undefined contents
+        bool failed = !batch->copiesSubmitted || (usesTransferQueue() && !batch->acquireSubmitted);
+        if (failed)
+            m_FailedTickets.insert(batch->ticket);
+        // Nothing waited on the semaphore signaled by the copies, a new one replaces it before the batch is reused
+        if (batch->copiesSubmitted && usesTransferQueue() && !batch->acquireSubmitted)
+            recreateSemaphore(batch);
+
+        // Batches complete in order, the ring tail follows the oldest one
+        m_Ring.release(batch->ringSize);
+        for (const StagingBuffer& staging : batch->stagingBuffers)
+            destroyStagingBuffer(staging);
+        batch->stagingBuffers.clear();
+
+        m_CompletedTicket = batch->ticket;
+        m_SubmittedBatches.pop_front();
+        m_FreeBatches.push_back(batch);
+    }
+}
+
+void UploadManager::recreateSemaphore(Batch* batch)
+{
+    vkDestroySemaphore(m_Device->device(), batch->semaphore, nullptr);
+    batch->semaphore = VK_NULL_HANDLE;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(m_Device->device(), &semaphoreInfo, nullptr, &batch->semaphore) != VK_SUCCESS)
+        V_LOG_ERROR("Unable to create upload semaphore.");
+}
+
+bool UploadManager::allocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+{
+    VkDeviceSize reserved;
+    if (!m_Ring.allocate(size, offset, reserved))
+        return false;
+
+    m_Recording->ringSize += reserved;
+    return true;
+}
+
+bool UploadManager::createStagingBuffer(const void* data, VkDeviceSize size, StagingBuffer& staging)
+{
+    VkBufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = size;
+    createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    staging = {};
+    if (vkCreateBuffer(m_Device->device(), &createInfo, nullptr, &staging.buffer) != VK_SUCCESS)
+    {
+        V_LOG_ERROR("Unable to create staging buffer.");
+        return false;
+    }
+
+    if (!m_Allocator->allocateForBuffer(staging.buffer,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        staging.memory) ||
+        !staging.memory.mapped)
+    {
+        V_LOG_ERROR("Failed to allocate required memory for staging buffer.");
+        destroyStagingBuffer(staging);
+        return false;
+    }
+
+    vkBindBufferMemory(m_Device->device(), staging.buffer, staging.memory.memory, staging.memory.offset);
+    memcpy(staging.memory.mapped, data, static_cast<size_t>(size));
+    return true;
+}
+
+void UploadManager::destroyStagingBuffer(const StagingBuffer& staging)
+{
+    vkDestroyBuffer(m_Device->device(), staging.buffer, nullptr);
+    if (staging.memory.allocation)
+        m_Allocator->free(staging.memory);
+}
+
+}; // namespace vrender
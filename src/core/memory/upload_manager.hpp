@@ -0,0 +1,133 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+#include "core/memory/staging_ring.hpp"
+#include "core/vulkan/device.hpp"
+#include "utils/noncopyable.hpp"
+
+#include "vulkan/vulkan.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace vrender
+{
+
+// Batches uploads to device local resources. Data is copied into a persistently mapped staging ring and the copies
+// are recorded into one command buffer that is submitted with a fence once per frame, or earlier when the ring or a
+// caller asks for it. Staging memory is reused once the fence of its batch signals.
+// Copies run on the dedicated transfer queue where the device has one, the batch releases the resources to the
+// graphics family and signals a semaphore that a small acquire submission on the graphics queue waits on. Without
+// one everything is submitted to the graphics queue. Either way copies are visible to everything submitted to the
+// graphics queue after their batch, callers only wait when the device memory is reused or destroyed.
+// May be used from any thread.
+class UploadManager : private NonCopyable
+{
+public:
+    UploadManager(Device* device, DeviceMemoryAllocator* allocator, VkDeviceSize stagingSize);
+    ~UploadManager();
+
+    // Returns a ticket for isComplete and wait, 0 if the upload could not be recorded
+    uint64_t upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // Copies tightly packed texels to the first mip level and layer of an image whose contents are discarded, the
+    // image is left in finalLayout
+    uint64_t uploadImage(VkImage dstImage, VkImageAspectFlags aspect, VkExtent3D extent, const void* data,
+                         VkDeviceSize size, VkImageLayout finalLayout);
+
+    // Submits the uploads recorded so far
+    void flush();
+    // False for tickets whose batch failed to submit
+    bool isComplete(uint64_t ticket);
+    // Whether the batch of the ticket retired without reaching the graphics queue, the destinations of its uploads
+    // hold undefined contents and images are left in their old layout
+    bool isFailed(uint64_t ticket);
+    // Submits the batch of the ticket if needed and blocks until it has executed
+    void wait(uint64_t ticket);
+
+    // Called once per frame before the frame is recorded, submits pending uploads and recycles staging memory
+    void update();
+
+    inline VkDeviceSize stagingSize() const { return m_StagingSize; }
+    inline uint64_t submitCount() const { return m_SubmitCount; }
+    // Whether copies run on a queue family other than the graphics family
+    inline bool usesTransferQueue() const { return m_TransferFamily != m_GraphicsFamily; }
+
+private:
+    // Staging buffer for an upload larger than the ring, destroyed with its batch
+    struct StagingBuffer
+    {
+        VkBuffer buffer;
+        MemoryBlock memory;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE; // Signals after the copies
+        // Only created with a transfer queue, acquires ownership on the graphics queue after the semaphore
+        VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        VkFence acquireFence = VK_NULL_HANDLE;
+        uint64_t ticket = 0;
+        // A fence only signals if its submit went through
+        bool copiesSubmitted = false;
+        bool acquireSubmitted = false;
+        VkDeviceSize ringSize = 0; // Ring bytes held by the batch including skipped bytes at the wrap
+        std::vector<StagingBuffer> stagingBuffers;
+        // Recorded after the copies, ownership transfers with a transfer queue and layout transitions
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    bool createStagingRing();
+    bool createBatches();
+    bool createAcquireBatches();
+
+    // m_Mutex must be held by everything below
+    Batch* recordingBatch();
+    // Copies the data to staging memory, the batch may change when earlier batches have to be submitted first
+    bool stage(const void* data, VkDeviceSize size, Batch*& batch, VkBuffer& srcBuffer, VkDeviceSize& srcOffset);
+    void submit();
+    bool submitAcquire(Batch* batch);
+    // Returns the batches up to and including the ticket, waiting on their fences if wait is set
+    void retire(uint64_t ticket, bool wait);
+    void recreateSemaphore(Batch* batch);
+    bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+    bool createStagingBuffer(const void* data, VkDeviceSize size, StagingBuffer& staging);
+    void destroyStagingBuffer(const StagingBuffer& staging);
+
+    Device* m_Device;
+    DeviceMemoryAllocator* m_Allocator;
+
+    std::mutex m_Mutex;
+
+    uint32_t m_GraphicsFamily;
+    uint32_t m_TransferFamily;
+    VkQueue m_Queue;
+
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    VkCommandPool m_AcquireCommandPool = VK_NULL_HANDLE;
+    std::vector<Batch> m_Batches;
+    std::vector<Batch*> m_FreeBatches;
+    std::deque<Batch*> m_SubmittedBatches; // In submission order
+    Batch* m_Recording = nullptr;
+
+    VkBuffer m_StagingBuffer = VK_NULL_HANDLE;
+    MemoryBlock m_StagingMemory = {};
+    uint8_t* m_StagingData = nullptr;
+    VkDeviceSize m_StagingSize;
+    StagingRing m_Ring;
+
+    uint64_t m_NextTicket = 1;
+    uint64_t m_CompletedTicket = 0;
+    std::unordered_set<uint64_t> m_FailedTickets;
+    uint64_t m_SubmitCount = 0;
+
+    static constexpr uint32_t BATCH_COUNT = 4;
+    // Keeps copies from staging memory aligned for any texel block size
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+};
+
+}; // namespace vrender
@@ -8,19 +8,30 @@
 #include "glm/ext/matrix_transform.hpp"
 #include "glm/fwd.hpp"
 #include "scene/model/mesh.hpp"
+#include "scene/model/model.hpp"
 #include "utils/log.hpp"
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <tuple>
+
 namespace vrender
 {
+
+static const uint8_t PLACEHOLDER_TEXEL[4] = {255, 255, 255, 255};
+
 MeshRenderSystem::MeshRenderSystem()
     : System(GraphicsContext::get().world()),
       m_Renderer(GraphicsContext::get().device(), GraphicsContext::get().swapChain(), GraphicsContext::get().window()),
       m_DescriptorAllocator(GraphicsContext::get().device(), &m_Renderer.pipeline()),
       m_GlobalUniformHandler(sizeof(GlobalUBO)),
       m_DescriptorPool(&m_DescriptorAllocator, DESCRIPTOR_TYPES, FRAME_OVERLAP),
-      m_Texture("../assets/models/Stool_Albedo.png")
+      m_MaterialAllocator(m_Renderer.pipeline().materialSetLayout()),
+      m_MaterialPool(&m_MaterialAllocator, MATERIAL_DESCRIPTOR_TYPES, 1, MAX_MATERIAL_SETS),
+      m_PlaceholderTexture(1, 1, PLACEHOLDER_TEXEL)
 {
+    writeTexture(m_MaterialPool.descriptorSets()[0], m_PlaceholderTexture);
+
     for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
     {
         VkDescriptorBufferInfo bufferInfo = {};
@@ -28,12 +39,7 @@ MeshRenderSystem::MeshRenderSystem()
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(GlobalUBO);
 
-        VkDescriptorImageInfo imageInfo = {};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_Texture.imageView();
-        imageInfo.sampler = m_Texture.sampler();
-
-        std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[0].dstSet = m_DescriptorPool.descriptorSets()[i];
         descriptorWrites[0].dstBinding = 0;
@@ -50,15 +56,7 @@ MeshRenderSystem::MeshRenderSystem()
         descriptorWrites[1].descriptorCount = 1;
         descriptorWrites[1].pBufferInfo = &bufferInfo;
 
-        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[2].dstSet = m_DescriptorPool.descriptorSets()[i];
-        descriptorWrites[2].dstBinding = 2;
-        descriptorWrites[2].dstArrayElement = 0;
-        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(GraphicsContext::get().device()->device(), 3, descriptorWrites.data(), 0, nullptr);
+        vkUpdateDescriptorSets(GraphicsContext::get().device()->device(), 2, descriptorWrites.data(), 0, nullptr);
     }
 }
 void MeshRenderSystem::start()
@@ -72,43 +70,214 @@ void MeshRenderSystem::update()
 {
     VkCommandBuffer commandBuffer = m_Renderer.beginFrame();
     m_Renderer.beginRenderPass();
-    m_Renderer.pipeline().bind(commandBuffer);
+
+    updateGlobalUniforms();
+
+    // The fence of the frame has been waited on
+    m_Frame++;
+    releaseMaterialSets();
+
+    collectDraws();
+
+    // Meshes share the buffers of their pool chunk, buffers are only bound again when the chunk changes. Materials
+    // are bound the same way
+    GeometryPool* geometryPool = GraphicsContext::get().geometryPool();
+    Pipeline* boundPipeline = nullptr;
+    uint32_t boundChunk = UINT32_MAX;
+    const Material* boundMaterial = nullptr;
+    VkDescriptorSet boundMaterialSet = VK_NULL_HANDLE;
+
+    for (const DrawItem& draw : m_Draws)
+    {
+        if (draw.pipeline != boundPipeline)
+        {
+            boundPipeline = draw.pipeline;
+            boundPipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline->layout(), 0, 1,
+                                    &m_DescriptorPool.descriptorSets()[m_Renderer.currentFrame()], 0, nullptr);
+            boundMaterialSet = VK_NULL_HANDLE;
+        }
+
+        if (draw.material != boundMaterial || boundMaterialSet == VK_NULL_HANDLE)
+        {
+            boundMaterial = draw.material;
+            VkDescriptorSet descriptorSet = materialSet(draw.material);
+            if (descriptorSet != boundMaterialSet)
+            {
+                boundMaterialSet = descriptorSet;
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline->layout(), 1,
+                                        1, &boundMaterialSet, 0, nullptr);
+            }
+        }
+
+        PushData pushData = {draw.model, draw.material ? draw.material->baseColor : glm::vec4(1.0f)};
+        vkCmdPushConstants(commandBuffer, boundPipeline->layout(),
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushData), &pushData);
+
+        if (draw.chunk != boundChunk)
+        {
+            geometryPool->bind(commandBuffer, draw.chunk);
+            boundChunk = draw.chunk;
+        }
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+    }
+
+    m_Renderer.endRenderPass();
+    m_Renderer.endFrame();
+}
+
+void MeshRenderSystem::collectDraws()
+{
+    m_Draws.clear();
 
     // TODO: Don't do this each frame?
     for (Entity* entity : entities())
     {
-        if (entity->hasComponent<Mesh>() &&
-            entity->hasComponent<Transform>()) // TODO: Instead of checking for Mesh, create Renderable type check?
+        Transform* transform = entity->getComponent<Transform>();
+        if (!transform)
+            continue;
+
+        // Meshes still loading are skipped
+        Mesh* mesh = entity->getComponent<Mesh>();
+        const Material* material = nullptr;
+        if (!mesh && entity->hasComponent<MeshInstance>())
         {
-            Transform* transform = entity->getComponent<Transform>();
-            Mesh* mesh = entity->getComponent<Mesh>();
+            MeshInstance* instance = entity->getComponent<MeshInstance>();
+            mesh = instance->mesh->get();
+            material = instance->material.get();
+        }
+        ModelNode* modelNode = entity->getComponent<ModelNode>();
+        if (!mesh && modelNode)
+            mesh = modelNode->mesh.get();
+        if (!mesh || mesh->geometry().indexCount == 0)
+            continue;
 
-            glm::mat4 model(1.0f);
-            model = glm::translate(model, transform->position);
-            model = glm::scale(model, transform->scale);
-            model *= glm::toMat4(transform->rotation);
+        const GeometryHandle& geometry = mesh->geometry();
+        DrawItem draw = {};
+        draw.pipeline = &m_Renderer.pipeline(mesh->layout());
+        draw.chunk = geometry.chunk;
+        draw.vertexOffset = geometry.vertexOffset;
+        draw.model = transform->worldMatrix() * mesh->dequantization();
+        draw.material = material;
 
-            PushData pushData = {model};
+        if (!modelNode)
+        {
+            draw.firstIndex = geometry.firstIndex;
+            draw.indexCount = geometry.indexCount;
+            m_Draws.push_back(draw);
+            continue;
+        }
+
+        for (const SubMesh& subMesh : modelNode->subMeshes)
+        {
+            draw.firstIndex = geometry.firstIndex + subMesh.firstIndex;
+            draw.indexCount = subMesh.indexCount;
+            draw.material = modelNode->materials && subMesh.material < modelNode->materials->size()
+                                ? &(*modelNode->materials)[subMesh.material]
+                                : nullptr;
+            m_Draws.push_back(draw);
+        }
+    }
 
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Renderer.pipeline().layout(), 0,
-                                    1, &m_DescriptorPool.descriptorSets()[m_Renderer.currentFrame()], 0, nullptr);
+    // Draws sharing a pipeline, chunk and material end up next to each other and skip the rebinds
+    std::sort(m_Draws.begin(), m_Draws.end(), [](const DrawItem& a, const DrawItem& b) {
+        return std::tie(a.pipeline, a.chunk, a.material) < std::tie(b.pipeline, b.chunk, b.material);
+    });
+}
 
-            glm::mat4 proj = m_Scene->camera()->projection();
-            glm::mat4 view = m_Scene->camera()->view();
-            glm::mat4 projView = m_Scene->camera()->projection() * m_Scene->camera()->view();
-            GlobalUBO ubo = {projView};
+VkDescriptorSet MeshRenderSystem::materialSet(const Material* material)
+{
+    if (!material || !material->baseColorTexture || !material->baseColorTexture->ready())
+        return m_MaterialPool.descriptorSets()[0];
 
-            m_GlobalUniformHandler.buffer()->copyData((void*)&ubo, sizeof(GlobalUBO));
+    const Texture* texture = material->baseColorTexture->get();
+    auto it = m_MaterialSets.find(texture);
+    if (it == m_MaterialSets.end())
+    {
+        // Drawn untextured while the pool is full
+        VkDescriptorSet descriptorSet = m_MaterialPool.allocate();
+        if (descriptorSet == VK_NULL_HANDLE)
+            return m_MaterialPool.descriptorSets()[0];
 
-            vkCmdPushConstants(commandBuffer, m_Renderer.pipeline().layout(), VK_SHADER_STAGE_VERTEX_BIT, 0,
-                               sizeof(PushData), &pushData);
+        writeTexture(descriptorSet, *texture);
+        it = m_MaterialSets.emplace(texture, MaterialSet{material->baseColorTexture, descriptorSet, m_Frame}).first;
+    }
+    it->second.lastUsed = m_Frame;
+    return it->second.descriptorSet;
+}
 
-            mesh->vertexBuffer()->bind(commandBuffer);
-            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(mesh->vertexBuffer()->indices().size()), 1, 0, 0, 0);
+void MeshRenderSystem::releaseMaterialSets()
+{
+    for (auto it = m_MaterialSets.begin(); it != m_MaterialSets.end();)
+    {
+        if (m_Frame - it->second.lastUsed >= FRAME_OVERLAP)
+        {
+            m_MaterialPool.free(it->second.descriptorSet);
+            it = m_MaterialSets.erase(it);
+        }
+        else
+        {
+            it++;
         }
     }
+}
 
-    m_Renderer.endRenderPass();
-    m_Renderer.endFrame();
+void MeshRenderSystem::writeTexture(VkDescriptorSet descriptorSet, const Texture& texture)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = texture.imageView();
+    imageInfo.sampler = texture.sampler();
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(GraphicsContext::get().device()->device(), 1, &descriptorWrite, 0, nullptr);
+}
+
+void MeshRenderSystem::updateGlobalUniforms()
+{
+    GlobalUBO ubo = {m_Scene->camera()->projection() * m_Scene->camera()->view()};
+
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.range = sizeof(GlobalUBO);
+
+    FrameAllocation allocation;
+    VkDeviceSize alignment = GraphicsContext::get().device()->limits().minUniformBufferOffsetAlignment;
+    if (GraphicsContext::get().frameAllocator()->allocate(sizeof(GlobalUBO), alignment, allocation))
+    {
+        memcpy(allocation.data, &ubo, sizeof(GlobalUBO));
+        bufferInfo.buffer = allocation.buffer;
+        bufferInfo.offset = allocation.offset;
+    }
+    else
+    {
+        m_GlobalUniformHandler.buffer()->copyData((void*)&ubo, sizeof(GlobalUBO));
+        bufferInfo.buffer = m_GlobalUniformHandler.buffer()->buffer();
+        bufferInfo.offset = 0;
+    }
+
+    // The descriptor set of this frame is no longer in use once its fence has signaled
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = m_DescriptorPool.descriptorSets()[m_Renderer.currentFrame()];
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfo;
+    }
+
+    vkUpdateDescriptorSets(GraphicsContext::get().device()->device(), static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
 }
 } // namespace vrender
\ No newline at end of file
@@ -6,15 +6,20 @@
 #include "core/vulkan/uniform.hpp"
 #include "ecs/system.hpp"
 #include "glm/fwd.hpp"
+#include "scene/asset_manager.hpp"
 #include "scene/scene.hpp"
 
+#include <array>
+#include <unordered_map>
+
 namespace vrender
 {
 
-const std::vector<VkDescriptorType> DESCRIPTOR_TYPES = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
+const std::vector<VkDescriptorType> DESCRIPTOR_TYPES = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER};
+const std::vector<VkDescriptorType> MATERIAL_DESCRIPTOR_TYPES = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
 
 constexpr uint32_t FRAME_OVERLAP = 2;
+constexpr uint32_t MAX_MATERIAL_SETS = 256; // Textures drawn with at the same time
 
 struct GlobalUBO
 {
@@ -24,6 +29,18 @@ struct GlobalUBO
 struct PushData
 {
     glm::mat4 model;
+    glm::vec4 baseColor;
+};
+
+struct DrawItem
+{
+    Pipeline* pipeline;
+    uint32_t chunk;
+    const Material* material; // Untextured white if null
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    glm::mat4 model;
 };
 
 class RenderSystem : private NonCopyable
@@ -42,12 +59,37 @@ public:
     virtual void update() override;
 
 private:
+    // Writes the global uniforms for the current frame into transient frame memory
+    void updateGlobalUniforms();
+    // Fills m_Draws with the resident meshes and model nodes, sorted to minimize state changes
+    void collectDraws();
+    // Set 1 of the material, the placeholder set while the material has no texture or it is not ready yet
+    VkDescriptorSet materialSet(const Material* material);
+    // Frees the sets no frame in flight has drawn with
+    void releaseMaterialSets();
+    void writeTexture(VkDescriptorSet descriptorSet, const Texture& texture);
+
+    struct MaterialSet
+    {
+        AssetHandle<Texture> texture; // Kept loaded while the set exists
+        VkDescriptorSet descriptorSet;
+        uint64_t lastUsed; // Frame the set was last drawn with
+    };
+
     Renderer m_Renderer;
     UniformHandler m_GlobalUniformHandler;
 
     DescriptorSetAllocator m_DescriptorAllocator;
     DescriptorPool m_DescriptorPool;
 
-    Texture m_Texture; // TODO: Make into component or something instead
+    DescriptorSetAllocator m_MaterialAllocator;
+    DescriptorPool m_MaterialPool; // The first set samples the placeholder
+
+    Texture m_PlaceholderTexture; // 1x1 white
+    // Keyed by texture, materials with the same texture share its set
+    std::unordered_map<const Texture*, MaterialSet> m_MaterialSets;
+    uint64_t m_Frame = 0;
+
+    std::vector<DrawItem> m_Draws; // Reused every frame
 };
 } // namespace vrender
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "renderer.hpp"
 
+#include "core/graphics_context.hpp"
 #include "scene/model/mesh.hpp"
 #include "utils/log.hpp"
 
@@ -20,6 +21,17 @@ Renderer::Renderer(Device* device, SwapChain* swapChain, Window* window)
 
 Renderer::~Renderer() {}
 
+Pipeline& Renderer::pipeline(const VertexLayout& layout)
+{
+    if (layout == m_Pipeline.vertexLayout())
+        return m_Pipeline;
+
+    std::unique_ptr<Pipeline>& pipeline = m_LayoutPipelines[layout.key()];
+    if (!pipeline)
+        pipeline = std::make_unique<Pipeline>(layout);
+    return *pipeline;
+}
+
 void Renderer::init()
 {
     createCommandBuffers();
@@ -35,6 +47,16 @@ VkCommandBuffer Renderer::beginFrame()
         return VK_NULL_HANDLE;
     }
 
+    // Fence for this frame has been waited on in aquireNextImage, its transient memory is free again
+    GraphicsContext::get().frameAllocator()->beginFrame(m_CurrentFrame);
+    GraphicsContext::get().deviceMemoryAllocator()->update();
+    // Uploads are submitted before any defragmentation copy can read their destination
+    GraphicsContext::get().uploadManager()->update();
+    GraphicsContext::get().geometryPool()->update();
+    // Assets only appear between frames
+    GraphicsContext::get().assetManager()->update();
+    GraphicsContext::get().defragmenter()->update();
+
     VkCommandBuffer commandBuffer = m_CommandBuffers[m_CurrentFrame];
 
     VkCommandBufferBeginInfo beginInfo = {};
@@ -56,6 +78,9 @@ VkResult Renderer::endFrame()
     if (commandResult != VK_SUCCESS)
         return commandResult;
 
+    // Buffers uploaded while the frame was recorded have to be written before it executes
+    GraphicsContext::get().uploadManager()->flush();
+
     VkResult queuePresentResult = m_SwapChain->submitCommandBuffers(&m_CommandBuffers[m_CurrentFrame], m_CurrentImage);
     if (queuePresentResult == VK_ERROR_DEVICE_LOST) {
         V_LOG_ERROR("Error during queue submit");
@@ -12,6 +12,8 @@
 
 #include "utils/noncopyable.hpp"
 
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -39,6 +41,8 @@ public:
     void endRenderPass();
 
     inline Pipeline& pipeline() { return m_Pipeline; }
+    // Pipeline for meshes of a vertex layout, created on first use
+    Pipeline& pipeline(const VertexLayout& layout);
     inline SwapChain* swapChain() { return m_SwapChain; }
     inline uint32_t currentFrame() const { return m_CurrentFrame; }
 
@@ -52,6 +56,7 @@ protected:
     Window* m_Window;
 
     Pipeline m_Pipeline;
+    std::unordered_map<uint32_t, std::unique_ptr<Pipeline>> m_LayoutPipelines; // Keyed by VertexLayout::key
 
     std::vector<VkCommandBuffer> m_CommandBuffers;
     uint32_t m_CurrentFrame = 0;
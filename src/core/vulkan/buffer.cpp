@@ -1,10 +1,14 @@
 #include "buffer.hpp"
 #include "core/graphics_context.hpp"
 #include "core/memory/memory_allocator.hpp"
-#include "core/vulkan/command_buffer.hpp"
 #include "utils/log.hpp"
 #include <vulkan/vulkan_core.h>
 
+#include <cstring>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
 namespace vrender
 {
 
@@ -38,118 +42,155 @@ bool Buffer::createBuffer(const BufferInfo& bufferInfo, VkBuffer& buffer, Memory
         return false;
     }
 
-    VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(GraphicsContext::get().device()->device(), buffer, &memoryRequirements);
-
-    uint32_t typeIndex;
-    if (!DeviceMemoryAllocator::findMemoryType(GraphicsContext::get().device()->physicalDevice(), memoryRequirements.memoryTypeBits,
-                                               bufferInfo.memoryProperties, typeIndex))
+    if (!GraphicsContext::get().deviceMemoryAllocator()->allocateForBuffer(buffer, bufferInfo.memoryProperties, memory))
     {
-        V_LOG_ERROR("Failed to find required memory for buffer.");
+        V_LOG_ERROR("Failed to allocate required memory for buffer.");
         return false;
     }
-    GraphicsContext::get().deviceMemoryAllocator()->allocate(memoryRequirements.size, memoryRequirements.alignment,
-                                                             typeIndex, memory);
 
     vkBindBufferMemory(GraphicsContext::get().device()->device(), buffer, memory.memory, memory.offset);
 
     return true;
 }
 
-void* Buffer::copyData(void* src, size_t size, size_t offset)
+void* Buffer::copyData(const void* src, size_t size, size_t offset)
 {
-    void* data;
-    vkMapMemory(GraphicsContext::get().device()->device(), m_Memory.memory, m_Memory.offset, size, 0, &data);
+    if (!m_Memory.mapped)
+    {
+        V_LOG_ERROR("Unable to copy data, buffer memory is not host visible.");
+        return nullptr;
+    }
+
+    void* data = static_cast<uint8_t*>(m_Memory.mapped) + offset;
     memcpy(data, src, size);
-    vkUnmapMemory(GraphicsContext::get().device()->device(), m_Memory.memory);
+    GraphicsContext::get().deviceMemoryAllocator()->flush(m_Memory, offset, size);
     return data;
 }
 
-// ----------- VertexBuffer --------------
-VertexBuffer::VertexBuffer(std::vector<Vertex> vertices, std::vector<uint16_t> indices)
-    : m_Vertices(vertices), m_Indices(indices)
+// ----------- VertexLayout --------------
+static uint32_t positionSize(PositionFormat format)
 {
-    createVertexBuffer();
-    createIndexBuffer();
+    // Three component 16-bit formats are rarely supported for vertex input, the fourth one is padding
+    return format == PositionFormat::Float32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
 }
 
-VertexBuffer::~VertexBuffer()
+static uint32_t texCoordSize(TexCoordFormat format)
 {
-    vkDestroyBuffer(GraphicsContext::get().device()->device(), m_IndexBuffer, nullptr);
-    GraphicsContext::get().deviceMemoryAllocator()->free(m_IndexMemory);
+    return format == TexCoordFormat::Float32 ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
 }
 
-void VertexBuffer::createVertexBuffer()
+// Flat axes keep a non zero scale so they decode to the bounds
+static glm::vec3 quantizationExtent(const Bounds& bounds)
 {
-    BufferInfo bufferInfo = {};
-    bufferInfo.size = m_Vertices.size() * sizeof(Vertex);
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    createBuffer(bufferInfo, m_StagingBuffer, m_StagingMemory);
-
-    void* data;
-    vkMapMemory(GraphicsContext::get().device()->device(), m_StagingMemory.memory, m_StagingMemory.offset, bufferInfo.size, 0, &data);
-    memcpy(data, m_Vertices.data(), (size_t)bufferInfo.size);
-    vkUnmapMemory(GraphicsContext::get().device()->device(), m_StagingMemory.memory);
-
-    bufferInfo.size = m_Vertices.size() * sizeof(Vertex);
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    bufferInfo.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    createBuffer(bufferInfo, m_Buffer, m_Memory);
-    copyBuffer(m_Buffer, bufferInfo.size);
-
-    vkDestroyBuffer(GraphicsContext::get().device()->device(), m_StagingBuffer, nullptr);
-    GraphicsContext::get().deviceMemoryAllocator()->free(m_StagingMemory);
+    glm::vec3 extent = bounds.max - bounds.min;
+    return glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f,
+                     extent.z > 0.0f ? extent.z : 1.0f);
 }
 
-void VertexBuffer::createIndexBuffer()
+uint32_t VertexLayout::stride() const
 {
-    BufferInfo bufferInfo = {};
-    bufferInfo.size = m_Indices.size() * sizeof(uint16_t);
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return positionSize(position) + texCoordSize(texCoord);
+}
 
-    createBuffer(bufferInfo, m_StagingBuffer, m_StagingMemory);
+VkVertexInputBindingDescription VertexLayout::bindingDescription() const
+{
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescription.stride = stride();
+    bindingDescription.binding = 0;
+    return bindingDescription;
+}
 
-    void* data;
-    vkMapMemory(GraphicsContext::get().device()->device(), m_StagingMemory.memory, m_StagingMemory.offset, bufferInfo.size, 0, &data);
-    memcpy(data, m_Indices.data(), (size_t)bufferInfo.size);
-    vkUnmapMemory(GraphicsContext::get().device()->device(), m_StagingMemory.memory);
+std::array<VkVertexInputAttributeDescription, 2> VertexLayout::attributeDescriptions() const
+{
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
 
-    bufferInfo.size = m_Indices.size() * sizeof(uint16_t);
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    bufferInfo.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].format =
+        position == PositionFormat::Float32 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = 0;
 
-    createBuffer(bufferInfo, m_IndexBuffer, m_IndexMemory);
-    copyBuffer(m_IndexBuffer, bufferInfo.size);
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].binding = 0;
+    switch (texCoord)
+    {
+    case TexCoordFormat::Float32:
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        break;
+    case TexCoordFormat::Float16:
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        break;
+    case TexCoordFormat::Unorm16:
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;
+        break;
+    }
+    attributeDescriptions[1].offset = positionSize(position);
 
-    vkDestroyBuffer(GraphicsContext::get().device()->device(), m_StagingBuffer, nullptr);
-    GraphicsContext::get().deviceMemoryAllocator()->free(m_StagingMemory);
+    return attributeDescriptions;
 }
 
-void VertexBuffer::copyBuffer(const VkBuffer& dstBuffer, VkDeviceSize size)
+std::vector<uint8_t> VertexLayout::encode(const std::vector<Vertex>& vertices, const Bounds& bounds) const
 {
-    CommandBuffer cmdBuffer;
-    cmdBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    uint32_t vertexStride = stride();
+    uint32_t texCoordOffset = positionSize(position);
+    glm::vec3 extent = quantizationExtent(bounds);
 
-    VkBufferCopy copyRegion = {};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
+    std::vector<uint8_t> data(vertices.size() * vertexStride);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        uint8_t* out = data.data() + i * vertexStride;
+
+        if (position == PositionFormat::Float32)
+        {
+            memcpy(out, &vertices[i].position, 3 * sizeof(float));
+        }
+        else
+        {
+            uint64_t packed = glm::packUnorm4x16(glm::vec4((vertices[i].position - bounds.min) / extent, 0.0f));
+            memcpy(out, &packed, sizeof(packed));
+        }
+
+        uint32_t packedTexCoord;
+        switch (texCoord)
+        {
+        case TexCoordFormat::Float32:
+            memcpy(out + texCoordOffset, &vertices[i].texCoord, 2 * sizeof(float));
+            break;
+        case TexCoordFormat::Float16:
+            packedTexCoord = glm::packHalf2x16(vertices[i].texCoord);
+            memcpy(out + texCoordOffset, &packedTexCoord, sizeof(packedTexCoord));
+            break;
+        case TexCoordFormat::Unorm16:
+            packedTexCoord = glm::packUnorm2x16(vertices[i].texCoord);
+            memcpy(out + texCoordOffset, &packedTexCoord, sizeof(packedTexCoord));
+            break;
+        }
+    }
+    return data;
+}
 
-    vkCmdCopyBuffer(cmdBuffer.buffer(), m_StagingBuffer, dstBuffer, 1, &copyRegion);
+glm::mat4 VertexLayout::dequantization(const Bounds& bounds) const
+{
+    if (position == PositionFormat::Float32)
+        return glm::mat4(1.0f);
 
-    cmdBuffer.submit_wait();
+    return glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), quantizationExtent(bounds));
 }
 
-void VertexBuffer::bind(const VkCommandBuffer& commandBuffer) const
+Bounds Bounds::fromVertices(const std::vector<Vertex>& vertices)
 {
-    VkBuffer vertexBuffers[] = {m_Buffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    Bounds bounds;
+    if (vertices.empty())
+        return bounds;
+
+    bounds.min = bounds.max = vertices[0].position;
+    for (const Vertex& vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.position);
+        bounds.max = glm::max(bounds.max, vertex.position);
+    }
+    return bounds;
 }
 
 UniformBuffer::UniformBuffer(const BufferInfo& bufferInfo) : Buffer(bufferInfo)
@@ -9,37 +9,67 @@
 namespace vrender
 {
 
+struct Vertex;
+struct Bounds;
+
+enum class PositionFormat
+{
+    Float32,
+    Unorm16 // Relative to the mesh bounds, mapped back by VertexLayout::dequantization in the model matrix
+};
+
+enum class TexCoordFormat
+{
+    Float32,
+    Float16,
+    Unorm16 // Clamped to [0, 1], only for coordinates that do not repeat
+};
+
+// Format of the vertices of a mesh in device memory, chosen at import. Meshes of different layouts are drawn with
+// different pipelines
+struct VertexLayout
+{
+    PositionFormat position = PositionFormat::Float32;
+    TexCoordFormat texCoord = TexCoordFormat::Float32;
+
+    uint32_t stride() const;
+    VkVertexInputBindingDescription bindingDescription() const;
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions() const;
+
+    // Packs vertices into the layout, quantized positions are stored relative to bounds
+    std::vector<uint8_t> encode(const std::vector<Vertex>& vertices, const Bounds& bounds) const;
+    // Maps decoded positions back to mesh space, identity unless positions are quantized
+    glm::mat4 dequantization(const Bounds& bounds) const;
+
+    inline uint32_t key() const { return static_cast<uint32_t>(position) | static_cast<uint32_t>(texCoord) << 8; }
+    inline bool operator==(const VertexLayout& other) const { return key() == other.key(); }
+    inline bool operator!=(const VertexLayout& other) const { return key() != other.key(); }
+};
+
 struct Vertex
 {
     glm::vec3 position;
     glm::vec2 texCoord;
 
-    static VkVertexInputBindingDescription getBindingDescription()
+    static VkVertexInputBindingDescription getBindingDescription(const VertexLayout& layout = VertexLayout())
     {
-        VkVertexInputBindingDescription bindingDescription = {};
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.binding = 0;
-        return bindingDescription;
+        return layout.bindingDescription();
     }
 
-    // TODO: Only 1 element for now, expand when adding texcoord, normal etc
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescription()
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescription(
+        const VertexLayout& layout = VertexLayout())
     {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
-
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, position);
+        return layout.attributeDescriptions();
+    }
+};
 
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, texCoord);
+// Axis aligned box around the positions of a set of vertices
+struct Bounds
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
 
-        return attributeDescriptions;
-    }
+    static Bounds fromVertices(const std::vector<Vertex>& vertices);
 };
 
 struct BufferInfo
@@ -56,9 +86,11 @@ public:
 
     ~Buffer();
 
-    void* copyData(void* src, size_t size, size_t offset = 0);
+    // Writes through the persistent mapping, returns the written address or nullptr if not host visible
+    void* copyData(const void* src, size_t size, size_t offset = 0);
 
     inline const VkBuffer& buffer() const { return m_Buffer; }
+    inline void* mapped() const { return m_Memory.mapped; }
 
 protected:
     Buffer() {}
@@ -70,34 +102,6 @@ protected:
     VkDeviceSize m_Size;
 };
 
-class VertexBuffer : public Buffer
-{
-public:
-    VertexBuffer(std::vector<Vertex> vertices, std::vector<uint16_t> indices);
-    ~VertexBuffer();
-
-    // TODO: Change if can bind multiple at a time
-    void bind(const VkCommandBuffer& commandBuffer) const;
-
-    inline std::vector<Vertex> vertices() const { return m_Vertices; }
-    inline std::vector<uint16_t> indices() const { return m_Indices; }
-    inline const VkBuffer& indexBuffer() const { return m_IndexBuffer; }
-
-private:
-    void createVertexBuffer();
-    void createIndexBuffer();
-    void copyBuffer(const VkBuffer& dstBuffer, VkDeviceSize size);
-
-    std::vector<Vertex> m_Vertices;
-    std::vector<uint16_t> m_Indices;
-
-    VkBuffer m_StagingBuffer;
-    MemoryBlock m_StagingMemory;
-
-    VkBuffer m_IndexBuffer;
-    MemoryBlock m_IndexMemory;
-};
-
 class UniformBuffer : public Buffer
 {
 public:
@@ -38,8 +38,9 @@ void CommandBuffer::submit_wait()
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &m_CommandBuffer;
 
-    vkQueueSubmit(GraphicsContext::get().device()->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(GraphicsContext::get().device()->graphicsQueue());
+    Device* device = GraphicsContext::get().device();
+    device->submit(device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+    device->waitIdle(device->graphicsQueue());
 }
 
 void CommandBuffer::submit()
@@ -51,6 +52,7 @@ void CommandBuffer::submit()
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &m_CommandBuffer;
 
-    vkQueueSubmit(GraphicsContext::get().device()->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+    Device* device = GraphicsContext::get().device();
+    device->submit(device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
 }
 } // namespace vrender
\ No newline at end of file
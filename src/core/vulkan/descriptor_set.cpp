@@ -7,10 +7,12 @@ namespace vrender
 {
 
 DescriptorPool::DescriptorPool(DescriptorSetAllocator* allocator,
-                               std::vector<VkDescriptorType> descriptorTypes, unsigned int descriptorCount)
+                               std::vector<VkDescriptorType> descriptorTypes, unsigned int descriptorCount,
+                               unsigned int capacity)
     : m_Allocator(allocator)
 {
-    createDescriptorPool(descriptorTypes, descriptorCount + 10);
+    createDescriptorPool(descriptorTypes, descriptorCount + capacity + 10,
+                         capacity > 0 ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0);
     m_DescriptorSets = m_Allocator->allocate(m_Pool, descriptorCount);
 }
 
@@ -19,7 +21,19 @@ DescriptorPool::~DescriptorPool()
     vkDestroyDescriptorPool(GraphicsContext::get().device()->device(), m_Pool, nullptr);
 }
 
-VkResult DescriptorPool::createDescriptorPool(std::vector<VkDescriptorType> types, unsigned int descriptorCount)
+VkDescriptorSet DescriptorPool::allocate()
+{
+    // Failed allocations leave the set null
+    return m_Allocator->allocate(m_Pool, 1).front();
+}
+
+void DescriptorPool::free(VkDescriptorSet descriptorSet)
+{
+    vkFreeDescriptorSets(GraphicsContext::get().device()->device(), m_Pool, 1, &descriptorSet);
+}
+
+VkResult DescriptorPool::createDescriptorPool(std::vector<VkDescriptorType> types, unsigned int descriptorCount,
+                                              VkDescriptorPoolCreateFlags flags)
 {
     std::vector<VkDescriptorPoolSize> poolSizes;
 
@@ -33,6 +47,7 @@ VkResult DescriptorPool::createDescriptorPool(std::vector<VkDescriptorType> type
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = flags;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
     poolInfo.maxSets = static_cast<uint32_t>(descriptorCount);
@@ -46,6 +61,8 @@ DescriptorSetAllocator::DescriptorSetAllocator(Device* device, Pipeline* pipelin
 {
 }
 
+DescriptorSetAllocator::DescriptorSetAllocator(VkDescriptorSetLayout layout) : m_Layout(layout) {}
+
 DescriptorSetAllocator::~DescriptorSetAllocator()
 {
 }
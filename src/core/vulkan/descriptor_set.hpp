@@ -13,16 +13,22 @@ class Pipeline;
 class DescriptorPool : private NonCopyable
 {
 public:
+    // Allocates descriptorCount sets up front, capacity more sets can be allocated and freed later
     DescriptorPool(DescriptorSetAllocator* allocator, std::vector<VkDescriptorType> descriptorTypes,
-                   unsigned int descriptorCount);
+                   unsigned int descriptorCount, unsigned int capacity = 0);
     ~DescriptorPool();
 
     inline const std::vector<VkDescriptorSet>& descriptorSets() const { return m_DescriptorSets; }
 
+    // VK_NULL_HANDLE once the capacity is used up
+    VkDescriptorSet allocate();
+    void free(VkDescriptorSet descriptorSet);
+
     inline DescriptorSetAllocator* allocator() const { return m_Allocator; }
 
 private:
-    VkResult createDescriptorPool(std::vector<VkDescriptorType> types, unsigned int descriptorCount);
+    VkResult createDescriptorPool(std::vector<VkDescriptorType> types, unsigned int descriptorCount,
+                                  VkDescriptorPoolCreateFlags flags);
 
     VkDescriptorPool m_Pool;
 
@@ -35,6 +41,7 @@ class DescriptorSetAllocator
 {
 public:
     DescriptorSetAllocator(Device* device, Pipeline* pipeline);
+    DescriptorSetAllocator(VkDescriptorSetLayout layout);
     ~DescriptorSetAllocator();
 
     VkDescriptorSetLayout layout() const { return m_Layout; }
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <string>
 
 namespace vrender
 {
@@ -145,6 +146,10 @@ int Device::createLogicalDevice()
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {queueIndicies.graphicsFamily.value(),
                                               queueIndicies.presentFamily.value()};
+    if (queueIndicies.transferFamily.has_value())
+        uniqueQueueFamilies.insert(queueIndicies.transferFamily.value());
+    if (queueIndicies.computeFamily.has_value())
+        uniqueQueueFamilies.insert(queueIndicies.computeFamily.value());
 
     for (const uint32_t& queueFamilyIndex : uniqueQueueFamilies)
     {
@@ -169,8 +174,15 @@ int Device::createLogicalDevice()
     createInfo.pNext = NULL;
     createInfo.flags = 0;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
+    m_EnabledExtensions = m_DeviceExtensions;
+    for (const char* extension : m_OptionalDeviceExtensions)
+    {
+        if (isExtensionSupported(m_PhysicalDevice, extension))
+            m_EnabledExtensions.push_back(extension);
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_EnabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = m_EnabledExtensions.data();
 
 #ifndef NDEBUG
     createInfo.enabledLayerCount = static_cast<uint32_t>(m_ValidationLayers.size());
@@ -185,6 +197,22 @@ int Device::createLogicalDevice()
     vkGetDeviceQueue(m_Device, queueIndicies.graphicsFamily.value(), 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, queueIndicies.presentFamily.value(), 0, &m_PresentQueue);
 
+    m_TransferQueue = m_GraphicsQueue;
+    if (queueIndicies.transferFamily.has_value())
+        vkGetDeviceQueue(m_Device, queueIndicies.transferFamily.value(), 0, &m_TransferQueue);
+    m_ComputeQueue = m_GraphicsQueue;
+    if (queueIndicies.computeFamily.has_value())
+        vkGetDeviceQueue(m_Device, queueIndicies.computeFamily.value(), 0, &m_ComputeQueue);
+
+    for (VkQueue queue : {m_GraphicsQueue, m_PresentQueue, m_TransferQueue, m_ComputeQueue})
+        m_QueueMutexes[queue];
+
+    V_LOG_DEBUG("Queue families: graphics {}, transfer {}, compute {}", queueIndicies.graphicsFamily.value(),
+                queueIndicies.transferFamily.has_value() ? std::to_string(queueIndicies.transferFamily.value())
+                                                         : "shared",
+                queueIndicies.computeFamily.has_value() ? std::to_string(queueIndicies.computeFamily.value())
+                                                        : "shared");
+
     return createDeviceResult;
 }
 
@@ -306,6 +334,60 @@ bool Device::checkDeviceExtensionSupport(const VkPhysicalDevice& device)
     return true;
 }
 
+bool Device::isExtensionSupported(const VkPhysicalDevice& device, const char* extension)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    return std::find_if(availableExtensions.begin(), availableExtensions.end(), [&extension](auto x) {
+               return !std::string(x.extensionName).compare(extension);
+           }) != availableExtensions.end();
+}
+
+bool Device::isExtensionEnabled(const char* extension) const
+{
+    return std::find_if(m_EnabledExtensions.begin(), m_EnabledExtensions.end(), [&extension](const char* x) {
+               return !std::string(x).compare(extension);
+           }) != m_EnabledExtensions.end();
+}
+
+VkResult Device::submit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+{
+    std::lock_guard<std::mutex> lock(queueMutex(queue));
+    return vkQueueSubmit(queue, submitCount, submits, fence);
+}
+
+VkResult Device::present(VkQueue queue, const VkPresentInfoKHR& presentInfo)
+{
+    std::lock_guard<std::mutex> lock(queueMutex(queue));
+    return vkQueuePresentKHR(queue, &presentInfo);
+}
+
+VkResult Device::waitIdle(VkQueue queue)
+{
+    std::lock_guard<std::mutex> lock(queueMutex(queue));
+    return vkQueueWaitIdle(queue);
+}
+
+VkResult Device::waitIdle()
+{
+    // Always locked in the order of the map and no other path holds more than one queue lock
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(m_QueueMutexes.size());
+    for (auto& [queue, mutex] : m_QueueMutexes)
+        locks.emplace_back(mutex);
+    return vkDeviceWaitIdle(m_Device);
+}
+
+std::mutex& Device::queueMutex(VkQueue queue)
+{
+    // The map is not modified after device creation, lookups from several threads are safe
+    return m_QueueMutexes.find(queue)->second;
+}
+
 int Device::checkPhysicalDevice(const VkPhysicalDevice& device)
 {
     VkPhysicalDeviceProperties deviceProperties;
@@ -378,23 +460,36 @@ QueueFamilyIndices Device::getQueueFamilies(const VkPhysicalDevice& device)
     VkBool32 presentSupport = false;
     for (const VkQueueFamilyProperties& queueFamily : queueFamilies)
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-        {
-            indices.graphicsFamily = i;
-        }
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
-        if (presentSupport)
+        if (!indices.isComplete())
         {
-            indices.presentFamily = i;
-            presentSupport = false;
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                indices.graphicsFamily = i;
+            }
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+            if (presentSupport)
+            {
+                indices.presentFamily = i;
+                presentSupport = false;
+            }
         }
 
-        if (indices.isComplete())
-            break;
+        // Compute queues support transfers too, a family with transfers only is usually backed by a copy engine
+        bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        bool transfer = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+        if (!graphics && compute && !indices.computeFamily.has_value())
+            indices.computeFamily = i;
+        if (!graphics && !compute && transfer && !indices.transferFamily.has_value())
+            indices.transferFamily = i;
 
         i++;
     }
 
+    // Async compute families are the next best place for transfers
+    if (!indices.transferFamily.has_value())
+        indices.transferFamily = indices.computeFamily;
+
     return indices;
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <mutex>
 #include <optional>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -19,6 +21,9 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Families without graphics support, only set when the device exposes them
+    std::optional<uint32_t> transferFamily;
+    std::optional<uint32_t> computeFamily;
 
     inline bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 };
@@ -43,10 +48,25 @@ public:
     inline const VkPhysicalDevice physicalDevice() const { return m_PhysicalDevice; }
     inline const VkCommandPool commandPool() const { return m_CommandPool; }
     inline const VkQueue graphicsQueue() const { return m_GraphicsQueue; }
+    // Queues of the dedicated families, the graphics queue on devices without them
+    inline const VkQueue transferQueue() const { return m_TransferQueue; }
+    inline const VkQueue computeQueue() const { return m_ComputeQueue; }
+    inline bool hasTransferQueue() const { return m_TransferQueue != m_GraphicsQueue; }
+    inline bool hasComputeQueue() const { return m_ComputeQueue != m_GraphicsQueue; }
     inline VkDeviceSize memorySize() const { return m_MemorySize; };
     inline const VkPhysicalDeviceMemoryProperties memoryProperties() const { return m_MemoryProperties; }
     inline const VkPhysicalDeviceLimits limits() const { return m_Properties.limits; }
 
+    bool isExtensionEnabled(const char* extension) const;
+
+    // Queues must be externally synchronized, every submit, present and wait on a queue goes through these so they
+    // may be called from any thread. Queues shared by several families share the lock
+    VkResult submit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+    VkResult present(VkQueue queue, const VkPresentInfoKHR& presentInfo);
+    VkResult waitIdle(VkQueue queue);
+    // Waits for all queues, holding all their locks
+    VkResult waitIdle();
+
 private:
     int createVulkanInstance(const AppInfo& appInfo);
     int createLogicalDevice();
@@ -66,8 +86,10 @@ private:
     int checkPhysicalDevice(const VkPhysicalDevice& device); // Checks if physical device is suitable, returns "score"
 
     bool checkDeviceExtensionSupport(const VkPhysicalDevice& device);
+    bool isExtensionSupported(const VkPhysicalDevice& device, const char* extension);
 
     QueueFamilyIndices getQueueFamilies(const VkPhysicalDevice& device);
+    std::mutex& queueMutex(VkQueue queue);
     SwapChainSupportDetails getSwapChainSupport(const VkPhysicalDevice& device);
 
     VkResult createSurface();
@@ -80,6 +102,10 @@ private:
     VkDevice m_Device;
     VkQueue m_GraphicsQueue;
     VkQueue m_PresentQueue;
+    VkQueue m_TransferQueue;
+    VkQueue m_ComputeQueue;
+    // One lock per distinct queue, only filled while the device is created
+    std::map<VkQueue, std::mutex> m_QueueMutexes;
     VkCommandPool m_CommandPool;
     VkSurfaceKHR m_Surface; // TODO: Move out of this class
     VkDeviceSize m_MemorySize;
@@ -96,5 +122,8 @@ private:
     const std::vector<const char*> m_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char*> m_DeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
                                                         "VK_KHR_portability_subset"};
+    // Enabled when the physical device supports them
+    const std::vector<const char*> m_OptionalDeviceExtensions = {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+    std::vector<const char*> m_EnabledExtensions;
 };
 }; // namespace vrender
@@ -1,95 +1,58 @@
 #include "image.hpp"
 #include "core/graphics_context.hpp"
-#include "core/vulkan/command_buffer.hpp"
 #include "utils/log.hpp"
 #include <vulkan/vulkan_core.h>
 
 namespace vrender
 {
 
-Image::Image(const ImageInfo& imageInfo) : m_Info(imageInfo)
+Image::Image(const ImageInfo& imageInfo, bool ownMemory) : m_Info(imageInfo), m_OwnsMemory(ownMemory)
 {
-    createImage(imageInfo, m_Image, m_Memory);
+    if (createImage(imageInfo, m_Image) && m_OwnsMemory && allocateMemory(imageInfo, m_Image, m_Memory) &&
+        vkBindImageMemory(GraphicsContext::get().device()->device(), m_Image, m_Memory.memory, m_Memory.offset) !=
+            VK_SUCCESS)
+    {
+        V_LOG_ERROR("Unable to bind image memory.");
+        GraphicsContext::get().deviceMemoryAllocator()->free(m_Memory);
+        m_Memory = {};
+    }
 }
 
 Image::~Image()
 {
     vkDestroyImage(GraphicsContext::get().device()->device(), m_Image, nullptr);
 
-    GraphicsContext::get().deviceMemoryAllocator()->free(m_Memory);
+    if (m_OwnsMemory && m_Memory.allocation)
+        GraphicsContext::get().deviceMemoryAllocator()->free(m_Memory);
 }
 
-void Image::transitionLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+VkMemoryRequirements Image::memoryRequirements() const
 {
-    CommandBuffer cmdBuffer;
-    cmdBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = m_Image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-    {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(GraphicsContext::get().device()->device(), m_Image, &requirements);
+    return requirements;
+}
 
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else
+bool Image::bindMemory(const MemoryBlock& memory, VkDeviceSize offset)
+{
+    if (m_OwnsMemory)
     {
-        V_LOG_ERROR("Unsupported image layout transition");
+        V_LOG_ERROR("Image already owns its memory.");
+        return false;
     }
 
-    vkCmdPipelineBarrier(cmdBuffer.buffer(), sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    cmdBuffer.submit_wait();
+    m_Memory = memory;
+    return vkBindImageMemory(GraphicsContext::get().device()->device(), m_Image, memory.memory,
+                             memory.offset + offset) == VK_SUCCESS;
 }
 
-void Image::copyBufferToImage(VkBuffer buffer)
+uint64_t Image::upload(const void* data, VkDeviceSize size, VkImageLayout finalLayout, VkImageAspectFlags aspect)
 {
-    CommandBuffer cmdBuffer;
-    cmdBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-    VkBufferImageCopy region = {};
-
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {m_Info.width, m_Info.height, 1};
-
-    vkCmdCopyBufferToImage(cmdBuffer.buffer(), buffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    cmdBuffer.submit_wait();
+    return GraphicsContext::get().uploadManager()->uploadImage(m_Image, aspect, {m_Info.width, m_Info.height, 1}, data,
+                                                               size, finalLayout);
 }
 
-bool Image::createImage(const ImageInfo& imageInfo, VkImage& image, MemoryBlock& memory)
+bool Image::createImage(const ImageInfo& imageInfo, VkImage& image)
 {
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -103,27 +66,32 @@ bool Image::createImage(const ImageInfo& imageInfo, VkImage& image, MemoryBlock&
     imageCreateInfo.tiling = imageInfo.tiling;
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageCreateInfo.usage = imageInfo.usage;
+    if (imageInfo.transient)
+        imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
-    vkCreateImage(GraphicsContext::get().device()->device(), &imageCreateInfo, nullptr, &m_Image);
-
-    VkMemoryRequirements memoryRequirements;
-    vkGetImageMemoryRequirements(GraphicsContext::get().device()->device(), m_Image, &memoryRequirements);
-
-    uint32_t typeIndex;
-    if (!DeviceMemoryAllocator::findMemoryType(GraphicsContext::get().device()->physicalDevice(), memoryRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, typeIndex))
+    if (vkCreateImage(GraphicsContext::get().device()->device(), &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
     {
-        V_LOG_ERROR("Failed to find required memory for texture.");
+        V_LOG_ERROR("Failed to create image.");
         return false;
     }
+    return true;
+}
 
-    GraphicsContext::get().deviceMemoryAllocator()->allocate(memoryRequirements.size, memoryRequirements.alignment,
-                                                             typeIndex, m_Memory);
-
-    vkBindImageMemory(GraphicsContext::get().device()->device(), m_Image, m_Memory.memory, 0);
+bool Image::allocateMemory(const ImageInfo& imageInfo, VkImage image, MemoryBlock& memory)
+{
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (imageInfo.transient)
+        properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
 
+    ResourceTiling tiling =
+        imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? ResourceTiling::Linear : ResourceTiling::Optimal;
+    if (!GraphicsContext::get().deviceMemoryAllocator()->allocateForImage(image, properties, memory, tiling))
+    {
+        V_LOG_ERROR("Failed to allocate required memory for texture.");
+        return false;
+    }
     return true;
 }
 
@@ -14,26 +14,41 @@ struct ImageInfo
     VkImageTiling tiling;
     uint32_t width;
     uint32_t height;
+    // Attachment never loaded or stored outside a render pass, backed by lazily allocated memory where available
+    bool transient = false;
 };
 
 class Image : private NonCopyable
 {
 public:
-    Image(const ImageInfo& bufferInfo);
+    // Without ownMemory the image has no memory until bindMemory is called. Bound memory stays owned by the
+    // caller, which lets several images alias one block
+    Image(const ImageInfo& imageInfo, bool ownMemory = true);
 
     ~Image();
 
-    void transitionLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-    void copyBufferToImage(VkBuffer buffer);
+    VkMemoryRequirements memoryRequirements() const;
+    bool bindMemory(const MemoryBlock& memory, VkDeviceSize offset = 0);
 
+    // Replaces the contents with tightly packed texels through the upload manager, returns its ticket
+    uint64_t upload(const void* data, VkDeviceSize size, VkImageLayout finalLayout,
+                    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // False if the image could not be created, or has no memory although it owns its memory
+    inline bool valid() const { return m_Image != VK_NULL_HANDLE && (!m_OwnsMemory || m_Memory.allocation != nullptr); }
     inline const VkImage& image() const { return m_Image; }
+    inline bool transient() const { return m_Info.transient; }
+    inline const ImageInfo& info() const { return m_Info; }
+    inline const MemoryBlock& memory() const { return m_Memory; }
 
 protected:
-    bool createImage(const ImageInfo& bufferInfo, VkImage& image, MemoryBlock& memory);
+    bool createImage(const ImageInfo& imageInfo, VkImage& image);
+    bool allocateMemory(const ImageInfo& imageInfo, VkImage image, MemoryBlock& memory);
 
-    VkImage m_Image;
-    MemoryBlock m_Memory;
+    VkImage m_Image = VK_NULL_HANDLE;
+    MemoryBlock m_Memory = {};
     ImageInfo m_Info;
+    bool m_OwnsMemory;
 };
 
 class ImageView : private NonCopyable
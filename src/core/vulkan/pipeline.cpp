@@ -6,8 +6,8 @@
 
 namespace vrender
 {
-Pipeline::Pipeline()
-    : m_Shader("shader_bin/triangle.vert.spv", "shader_bin/triangle.frag.spv")
+Pipeline::Pipeline(const VertexLayout& vertexLayout)
+    : m_Shader("shader_bin/triangle.vert.spv", "shader_bin/triangle.frag.spv"), m_VertexLayout(vertexLayout)
 {
     createGraphicsDescriptorLayout();
     createGraphicsPipeline();
@@ -18,6 +18,7 @@ Pipeline::~Pipeline()
     vkDestroyPipeline(GraphicsContext::get().device()->device(), m_Pipeline, nullptr);
     vkDestroyPipelineLayout(GraphicsContext::get().device()->device(), m_Layout, nullptr);
     vkDestroyDescriptorSetLayout(GraphicsContext::get().device()->device(), m_DescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(GraphicsContext::get().device()->device(), m_MaterialSetLayout, nullptr);
 }
 
 void Pipeline::bind(const VkCommandBuffer& commandBuffer)
@@ -42,8 +43,8 @@ bool Pipeline::createGraphicsPipeline()
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageCreateInfo, fragStageCreateInfo};
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescription();
+    auto bindingDescription = Vertex::getBindingDescription(m_VertexLayout);
+    auto attributeDescriptions = Vertex::getAttributeDescription(m_VertexLayout);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -123,12 +124,14 @@ bool Pipeline::createGraphicsPipeline()
     VkPushConstantRange pushConstantRange = {};
     pushConstantRange.offset = 0;
     pushConstantRange.size = sizeof(PushData);
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayout setLayouts[] = {m_DescriptorSetLayout, m_MaterialSetLayout};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
-    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.setLayoutCount = 2;
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -191,19 +194,29 @@ bool Pipeline::createGraphicsDescriptorLayout()
     localBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     localBinding.pImmutableSamplers = nullptr;
 
+    VkDescriptorSetLayoutBinding bindings[] = {globalBinding, localBinding};
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(GraphicsContext::get().device()->device(), &layoutInfo, nullptr,
+                                    &m_DescriptorSetLayout) != VK_SUCCESS)
+        return false;
+
     VkDescriptorSetLayoutBinding samplerBinding = {};
-    samplerBinding.binding = 2;
+    samplerBinding.binding = 0;
     samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplerBinding.descriptorCount = 1;
     samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    VkDescriptorSetLayoutBinding bindings[] = {globalBinding, localBinding, samplerBinding};
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 3;
-    layoutInfo.pBindings = bindings;
+    VkDescriptorSetLayoutCreateInfo materialLayoutInfo = {};
+    materialLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    materialLayoutInfo.bindingCount = 1;
+    materialLayoutInfo.pBindings = &samplerBinding;
 
-    return vkCreateDescriptorSetLayout(GraphicsContext::get().device()->device(), &layoutInfo, nullptr, &m_DescriptorSetLayout) == VK_SUCCESS;
+    return vkCreateDescriptorSetLayout(GraphicsContext::get().device()->device(), &materialLayoutInfo, nullptr,
+                                       &m_MaterialSetLayout) == VK_SUCCESS;
 }
 }; // namespace vrender
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/vulkan/buffer.hpp"
 #include "core/vulkan/descriptor_set.hpp"
 #include "core/vulkan/shader.hpp"
 #include "core/vulkan/swap_chain.hpp"
@@ -11,18 +12,23 @@ namespace vrender
 class Pipeline : private NonCopyable
 {
 public:
-    Pipeline();
+    Pipeline(const VertexLayout& vertexLayout = VertexLayout());
     ~Pipeline();
 
     void bind(const VkCommandBuffer& commandBuffer);
 
     inline VkPipelineLayout layout() const { return m_Layout; }
     inline VkDescriptorSetLayout descriptorSetLayout() const { return m_DescriptorSetLayout; }
+    // Set 1, the textures of a material
+    inline VkDescriptorSetLayout materialSetLayout() const { return m_MaterialSetLayout; }
+    inline const VertexLayout& vertexLayout() const { return m_VertexLayout; }
 
 private:
     Shader m_Shader;
+    VertexLayout m_VertexLayout;
 
     VkDescriptorSetLayout m_DescriptorSetLayout;
+    VkDescriptorSetLayout m_MaterialSetLayout;
 
     VkPipeline m_Pipeline;
     VkPipelineLayout m_Layout;
@@ -15,7 +15,7 @@ namespace vrender
 SwapChain::SwapChain(Device* device, Window* window)
     : m_Window(window), m_Device(device),
       m_DepthImage(std::make_unique<Image>(ImageInfo{VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
-                            window->extent().width, window->extent().height})),
+                            window->extent().width, window->extent().height, true})),
       m_DepthImageView(std::make_unique<ImageView>(*m_DepthImage, VK_IMAGE_ASPECT_DEPTH_BIT, VK_FORMAT_D32_SFLOAT))
 {
     init();
@@ -43,13 +43,13 @@ void SwapChain::recreate()
         extent = m_Window->extent();
         glfwWaitEvents();
     }
-    VkResult result = vkDeviceWaitIdle(m_Device->device());
+    VkResult result = m_Device->waitIdle();
 
     cleanup();
 
     // TODO: Make depth images part of m_SwapChainImages?
     m_DepthImage = std::make_unique<Image>(ImageInfo{VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
-                            m_Window->extent().width, m_Window->extent().height});
+                            m_Window->extent().width, m_Window->extent().height, true});
     m_DepthImageView = std::make_unique<ImageView>(*m_DepthImage, VK_IMAGE_ASPECT_DEPTH_BIT, VK_FORMAT_D32_SFLOAT);
     createSwapChain();
     createImageViews();
@@ -136,7 +136,7 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffer, uint32_t
     vkResetFences(m_Device->device(), 1, &m_InFlightFences[m_CurrentFrame]);
 
     VkResult queueSubmitResult =
-        vkQueueSubmit(m_Device->graphicsQueue(), 1, &submitInfo, m_InFlightFences[m_CurrentFrame]);
+        m_Device->submit(m_Device->graphicsQueue(), 1, &submitInfo, m_InFlightFences[m_CurrentFrame]);
         
     if (queueSubmitResult != VK_SUCCESS)
         return queueSubmitResult;
@@ -152,7 +152,7 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffer, uint32_t
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
-    VkResult queuePresentResult = vkQueuePresentKHR(m_Device->graphicsQueue(), &presentInfo);
+    VkResult queuePresentResult = m_Device->present(m_Device->graphicsQueue(), presentInfo);
 
     if (queuePresentResult == VK_ERROR_OUT_OF_DATE_KHR || queuePresentResult == VK_SUBOPTIMAL_KHR ||
         m_Window->framebufferResized())
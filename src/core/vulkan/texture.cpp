@@ -13,13 +13,19 @@ namespace vrender
 
 Texture::Texture(const std::string& filepath) : m_Device(GraphicsContext::get().device())
 {
-    createTextureImage(filepath);
-    m_ImageView = std::make_unique<ImageView>(*m_Image, VK_IMAGE_ASPECT_COLOR_BIT, VK_FORMAT_R8G8B8A8_SRGB);
-    createSampler();
+    if (createTextureImage(filepath))
+        createViewAndSampler();
+}
+
+Texture::Texture(uint32_t width, uint32_t height, const void* pixels) : m_Device(GraphicsContext::get().device())
+{
+    if (createTextureImage(width, height, pixels))
+        createViewAndSampler();
 }
 
 Texture::~Texture()
 {
+    GraphicsContext::get().uploadManager()->wait(m_UploadTicket);
     vkDestroySampler(m_Device->device(), m_Sampler, nullptr);
 }
 
@@ -34,30 +40,46 @@ bool Texture::createTextureImage(const std::string& filepath)
         return false;
     }
 
-    VkDeviceSize texSize = width * height * 4;
-    BufferInfo bufferInfo = {texSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-    Buffer buffer(bufferInfo);
-    buffer.copyData(pixels, static_cast<size_t>(texSize));
+    bool created = createTextureImage(static_cast<uint32_t>(width), static_cast<uint32_t>(height), pixels);
+    stbi_image_free(pixels);
+
+    return created;
+}
+
+bool Texture::createTextureImage(uint32_t width, uint32_t height, const void* pixels)
+{
+    VkDeviceSize texSize = static_cast<VkDeviceSize>(width) * height * 4;
 
     ImageInfo imageInfo;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.width = static_cast<uint32_t>(width);
-    imageInfo.height = static_cast<uint32_t>(height);
+    imageInfo.width = width;
+    imageInfo.height = height;
 
     m_Image = std::make_unique<Image>(imageInfo);
-    m_Image->transitionLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    m_Image->copyBufferToImage(buffer.buffer());
-    m_Image->transitionLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (!m_Image->valid())
+    {
+        V_LOG_ERROR("Unable to create texture image of {}x{} texels.", width, height);
+        return false;
+    }
 
-    stbi_image_free(pixels);
+    m_UploadTicket = m_Image->upload(pixels, texSize, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (m_UploadTicket == 0)
+    {
+        V_LOG_ERROR("Unable to upload texture of {}x{} texels.", width, height);
+        return false;
+    }
 
     return true;
 }
 
+void Texture::createViewAndSampler()
+{
+    m_ImageView = std::make_unique<ImageView>(*m_Image, VK_IMAGE_ASPECT_COLOR_BIT, VK_FORMAT_R8G8B8A8_SRGB);
+    createSampler();
+}
+
 bool Texture::createSampler()
 {
     VkSamplerCreateInfo createInfo = {};
@@ -15,13 +15,25 @@ class Texture
 {
 public:
     Texture(const std::string& filepath);
+    // Tightly packed RGBA8 texels, e.g. for placeholders
+    Texture(uint32_t width, uint32_t height, const void* pixels);
+    // Destroys the image and sampler right away, no submitted frame may still use them
     ~Texture();
 
+    // False if the image could not be loaded, the view and sampler are not created then
+    inline bool loaded() const { return m_ImageView != nullptr; }
+
     inline VkImageView imageView() const { return m_ImageView->imageView(); }
     inline VkSampler sampler() const { return m_Sampler; }
+    // Only valid for a loaded texture
+    inline const MemoryBlock& memory() const { return m_Image->memory(); }
+    // Ticket of the image upload for UploadManager::isComplete
+    inline uint64_t uploadTicket() const { return m_UploadTicket; }
 
 private:
     bool createTextureImage(const std::string& filepath);
+    bool createTextureImage(uint32_t width, uint32_t height, const void* pixels);
+    void createViewAndSampler();
     bool createImageView();
     bool createSampler();
 
@@ -30,7 +42,8 @@ private:
     std::unique_ptr<Image> m_Image;
     std::unique_ptr<ImageView> m_ImageView;
 
-    VkSampler m_Sampler;
+    VkSampler m_Sampler = VK_NULL_HANDLE;
+    uint64_t m_UploadTicket = 0;
 
     Device* m_Device;
 };
@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cstdint>
 
+#include "glm/ext/matrix_transform.hpp"
 #include "glm/gtx/quaternion.hpp"
 #include "glm/vec3.hpp"
 
@@ -44,6 +45,14 @@ struct Transform : public Component
     glm::vec3 position;
     glm::vec3 scale = glm::vec3(1.0f);
     glm::quat rotation;
+    // Transform of the parent entity, which must outlive this one. Null for roots
+    Transform* parent = nullptr;
+
+    glm::mat4 localMatrix() const
+    {
+        return glm::translate(glm::mat4(1.0f), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+    glm::mat4 worldMatrix() const { return parent ? parent->worldMatrix() * localMatrix() : localMatrix(); }
 };
 
 } // namespace vrender
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "asset_manager.hpp"
+#include "scene/model/model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace vrender
+{
+
+AssetManager::AssetManager(ThreadPool* threadPool, UploadManager* uploadManager, DeviceMemoryAllocator* allocator,
+                           uint32_t frameCount)
+    : m_ThreadPool(threadPool), m_UploadManager(uploadManager), m_Allocator(allocator), m_FrameCount(frameCount)
+{
+    m_Allocator->registerBudgetHandler(this);
+}
+
+AssetManager::~AssetManager()
+{
+    m_Allocator->unregisterBudgetHandler(this);
+
+    // Tasks lock m_Mutex when they finish, so the futures are moved out first
+    std::vector<std::future<void>> loads;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        loads = std::move(m_Loads);
+    }
+    for (std::future<void>& load : loads)
+        load.wait();
+}
+
+AssetHandle<Mesh> AssetManager::loadMesh(const std::string& filepath, const VertexLayout& layout)
+{
+    std::string key = normalizedPath(filepath) + "#" + std::to_string(layout.key());
+    return load<Mesh>(m_Meshes, key, filepath,
+                      [filepath, layout]() { return std::make_unique<Mesh>(filepath, layout); });
+}
+
+AssetHandle<Texture> AssetManager::loadTexture(const std::string& filepath)
+{
+    return load<Texture>(m_Textures, normalizedPath(filepath), filepath,
+                         [filepath]() { return std::make_unique<Texture>(filepath); });
+}
+
+AssetHandle<Model> AssetManager::loadModel(const std::string& filepath, const VertexLayout& layout)
+{
+    std::string key = normalizedPath(filepath) + "#" + std::to_string(layout.key());
+    return load<Model>(m_Models, key, filepath,
+                       [filepath, layout]() { return std::make_unique<Model>(filepath, layout); });
+}
+
+void AssetManager::update()
+{
+    // Destroyed outside the lock, destroying a resource may wait for its upload
+    std::vector<std::shared_ptr<AssetBase>> released;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Frame++;
+
+    for (auto it = m_Retired.begin(); it != m_Retired.end();)
+    {
+        if (--it->frames == 0)
+        {
+            released.push_back(std::move(it->asset));
+            it = m_Retired.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    for (auto it = m_Loaded.begin(); it != m_Loaded.end();)
+    {
+        AssetBase* asset = it->get();
+        bool failed = false;
+        if (asset->m_UploadTicket != 0 && !m_UploadManager->isComplete(asset->m_UploadTicket))
+        {
+            // A failed upload retires like a complete one, its asset must not be published
+            failed = m_UploadManager->isFailed(asset->m_UploadTicket);
+            if (!failed)
+            {
+                ++it;
+                continue;
+            }
+        }
+
+        asset->m_State = !failed && asset->publish() ? AssetState::Ready : AssetState::Failed;
+        m_LoadingCount--;
+        it = m_Loaded.erase(it);
+    }
+
+    m_Loads.erase(std::remove_if(m_Loads.begin(), m_Loads.end(),
+                                 [](const std::future<void>& load) {
+                                     return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                 }),
+                  m_Loads.end());
+
+    // Mesh geometry goes back to the geometry pool rather than to the heap, there is no reason to keep it
+    updateCache(m_Meshes, false);
+    updateCache(m_Models, false);
+    updateCache(m_Textures, true);
+}
+
+void AssetManager::evict(uint32_t heapIndex, VkDeviceSize requiredSize)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::vector<Cache<Texture>::iterator> candidates;
+    for (auto it = m_Textures.begin(); it != m_Textures.end(); ++it)
+    {
+        const Texture* texture = it->second.asset->get();
+        if (unused(it->second) && texture && m_Allocator->heapIndex(texture->memory().typeIndex) == heapIndex)
+            candidates.push_back(it);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a->second.lastUsed < b->second.lastUsed; });
+
+    VkDeviceSize evictedSize = 0;
+    for (auto it : candidates)
+    {
+        if (evictedSize >= requiredSize)
+            break;
+        evictedSize += it->second.asset->get()->memory().size;
+        m_Retired.push_back({std::move(it->second.asset), m_FrameCount});
+        m_Textures.erase(it);
+    }
+    if (evictedSize > 0)
+        V_LOG_INFO("Evicted {} bytes of unused textures from memory heap {}.", evictedSize, heapIndex);
+}
+
+size_t AssetManager::loadingCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_LoadingCount;
+}
+
+size_t AssetManager::cachedCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Meshes.size() + m_Textures.size() + m_Models.size();
+}
+
+bool AssetManager::loaded(const Model& model)
+{
+    return model.loaded();
+}
+
+uint64_t AssetManager::uploadTicket(const Model& model)
+{
+    return model.mesh() ? model.mesh()->geometry().uploadTicket : 0;
+}
+
+std::string AssetManager::normalizedPath(const std::string& filepath)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::absolute(filepath, error);
+    if (error)
+        path = filepath;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return (error ? path : canonical).lexically_normal().generic_string();
+}
+
+}; // namespace vrender
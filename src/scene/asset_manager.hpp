@@ -0,0 +1,206 @@
+#pragma once
+
+#include "core/memory/memory_allocator.hpp"
+#include "core/memory/upload_manager.hpp"
+#include "core/vulkan/texture.hpp"
+#include "ecs/component.hpp"
+#include "scene/model/mesh.hpp"
+#include "utils/log.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/thread_pool.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vrender
+{
+
+class Model;
+struct Material;
+
+enum class AssetState
+{
+    Loading,
+    Ready,
+    Failed
+};
+
+class AssetBase : private NonCopyable
+{
+public:
+    virtual ~AssetBase() = default;
+
+    // May be queried from any thread
+    inline AssetState state() const { return m_State; }
+    inline bool ready() const { return m_State == AssetState::Ready; }
+
+protected:
+    friend class AssetManager;
+
+    // Makes the loaded resource visible to get(), returns false if there is none
+    virtual bool publish() = 0;
+
+    std::atomic<AssetState> m_State{AssetState::Loading};
+    uint64_t m_UploadTicket = 0; // Written by the loading thread before it hands the asset to the manager
+};
+
+// Resource loaded in the background. get() stays null until its upload has completed and the manager swapped it in
+// at the start of a frame, so a frame never sees a resource appear halfway through
+template <typename T> class Asset : public AssetBase
+{
+public:
+    // Belongs to the render thread
+    inline T* get() const { return m_Resource.get(); }
+
+private:
+    friend class AssetManager;
+
+    bool publish() override
+    {
+        m_Resource = std::move(m_Loaded);
+        return m_Resource != nullptr;
+    }
+
+    std::unique_ptr<T> m_Loaded; // Written by the loading thread
+    std::unique_ptr<T> m_Resource;
+};
+
+template <typename T> using AssetHandle = std::shared_ptr<Asset<T>>;
+
+// Mesh loaded by the asset manager, entities are not drawn until it is ready
+struct MeshInstance : public Component
+{
+    MeshInstance(AssetHandle<Mesh> mesh, std::shared_ptr<const Material> material = nullptr)
+        : mesh(std::move(mesh)), material(std::move(material))
+    {
+    }
+
+    AssetHandle<Mesh> mesh;
+    std::shared_ptr<const Material> material; // Untextured white if null
+};
+
+// Loads meshes, models and textures on the thread pool and returns their handles right away. Requests for a file that
+// is loaded or still loading share its asset, meshes and models also by vertex layout. Meshes and models are released
+// with their last handle.
+// Textures stay cached after their last handle is gone, until a heap runs over budget and the least recently used
+// are evicted. Released assets are destroyed once no submitted frame can use them. Load functions may be called from
+// any thread, update belongs to the render thread
+class AssetManager : public MemoryBudgetHandler, private NonCopyable
+{
+public:
+    AssetManager(ThreadPool* threadPool, UploadManager* uploadManager, DeviceMemoryAllocator* allocator,
+                 uint32_t frameCount);
+    // Waits for the loads still running
+    ~AssetManager();
+
+    AssetHandle<Mesh> loadMesh(const std::string& filepath, const VertexLayout& layout = VertexLayout());
+    AssetHandle<Texture> loadTexture(const std::string& filepath);
+    // The model is ready once its geometry is resident, its material textures keep loading as assets of their own
+    AssetHandle<Model> loadModel(const std::string& filepath, const VertexLayout& layout = VertexLayout());
+
+    // Called once per frame after the fence of the frame has been waited on and before the frame is recorded,
+    // publishes the assets whose uploads have completed and destroys the released ones no frame can use any more
+    void update();
+
+    // Releases unused textures, their memory returns once the frames in flight are done with them
+    void evict(uint32_t heapIndex, VkDeviceSize requiredSize) override;
+
+    // Assets not published yet
+    size_t loadingCount();
+    // Assets with a handle and unused textures
+    size_t cachedCount();
+
+private:
+    template <typename T> struct CacheEntry
+    {
+        AssetHandle<T> asset;
+        uint64_t lastUsed = 0; // Frame the asset last had a handle outside the manager
+    };
+    template <typename T> using Cache = std::unordered_map<std::string, CacheEntry<T>>;
+
+    struct Retired
+    {
+        std::shared_ptr<AssetBase> asset;
+        uint32_t frames; // Frames left until no submitted frame can use the asset
+    };
+
+    template <typename T, typename Create>
+    AssetHandle<T> load(Cache<T>& cache, const std::string& key, const std::string& filepath, Create create)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        CacheEntry<T>& entry = cache[key];
+        entry.lastUsed = m_Frame;
+        if (entry.asset)
+            return entry.asset;
+
+        AssetHandle<T> asset = std::make_shared<Asset<T>>();
+        entry.asset = asset;
+        m_LoadingCount++;
+        // The task gives up its reference under the lock, the worker may destroy the task after the future is ready
+        m_Loads.push_back(m_ThreadPool->submit([this, asset, filepath, create]() mutable {
+            std::unique_ptr<T> resource = create();
+            if (loaded(*resource))
+            {
+                asset->m_UploadTicket = uploadTicket(*resource);
+                asset->m_Loaded = std::move(resource);
+            }
+            else
+                V_LOG_ERROR("Unable to load asset {}.", filepath);
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Loaded.push_back(std::move(asset));
+        }));
+        return asset;
+    }
+
+    // Same file for different spellings of its path
+    static std::string normalizedPath(const std::string& filepath);
+    // Only the manager holds a handle
+    template <typename T> static bool unused(const CacheEntry<T>& entry) { return entry.asset.use_count() == 1; }
+    // Updates the frames assets were last used in and releases unused assets unless they are kept. Failed assets
+    // are never kept, so the next request tries again
+    template <typename T> void updateCache(Cache<T>& cache, bool keepUnused)
+    {
+        for (auto it = cache.begin(); it != cache.end();)
+        {
+            if (!unused(it->second))
+                it->second.lastUsed = m_Frame;
+            else if (!keepUnused || it->second.asset->state() == AssetState::Failed)
+            {
+                m_Retired.push_back({std::move(it->second.asset), m_FrameCount});
+                it = cache.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+
+    static bool loaded(const Mesh& mesh) { return mesh.geometry().indexCount > 0; }
+    static bool loaded(const Texture& texture) { return texture.loaded(); }
+    static uint64_t uploadTicket(const Mesh& mesh) { return mesh.geometry().uploadTicket; }
+    static uint64_t uploadTicket(const Texture& texture) { return texture.uploadTicket(); }
+    static bool loaded(const Model& model);
+    static uint64_t uploadTicket(const Model& model);
+
+    ThreadPool* m_ThreadPool;
+    UploadManager* m_UploadManager;
+    DeviceMemoryAllocator* m_Allocator;
+    uint32_t m_FrameCount;
+
+    std::mutex m_Mutex; // Guards everything below
+    std::vector<std::future<void>> m_Loads;
+    std::vector<std::shared_ptr<AssetBase>> m_Loaded; // Loaded, waiting for their uploads
+    std::vector<Retired> m_Retired;
+    size_t m_LoadingCount = 0;
+    uint64_t m_Frame = 0;
+    Cache<Mesh> m_Meshes;
+    Cache<Texture> m_Textures;
+    Cache<Model> m_Models;
+};
+
+}; // namespace vrender
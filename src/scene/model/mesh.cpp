@@ -1,62 +1,156 @@
 #include "mesh.hpp"
 
 #include "core/graphics_context.hpp"
+#include "scene/model/mesh_cache.hpp"
+#include "utils/log.hpp"
 
 #include "assimp/Importer.hpp"
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <chrono>
+#include <functional>
+
 namespace vrender
 {
 
-// NOTE: Careful with passing vertices and indices like this to vertex buffer, who deletes?
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint16_t> indices)
-    : m_VertexBuffer(vertices, indices)
+// Faces are triangulated on import, points and lines keep their own index count
+static uint32_t indexCount(const aiMesh* mesh)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < mesh->mNumFaces; i++)
+        count += mesh->mFaces[i].mNumIndices;
+    return count;
+}
+
+static void convertMesh(const aiMesh* mesh, uint32_t baseVertex, Vertex* vertices, uint32_t* indices)
+{
+    for (uint32_t i = 0; i < mesh->mNumVertices; i++)
+    {
+        vertices[i].position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        if (mesh->HasTextureCoords(0))
+            vertices[i].texCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+        else
+            vertices[i].texCoord = glm::vec2(0.0f);
+    }
+
+    // Indices of each mesh start at its first vertex
+    for (uint32_t i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        for (uint32_t j = 0; j < face.mNumIndices; j++)
+            *indices++ = baseVertex + face.mIndices[j];
+    }
+}
+
+// The geometry is copied into staging memory while uploading, the mesh keeps no copy of it
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, const VertexLayout& layout)
+    : m_Bounds(Bounds::fromVertices(vertices)), m_Layout(layout), m_Dequantization(layout.dequantization(m_Bounds))
+{
+    std::vector<uint8_t> vertexData = layout.encode(vertices, m_Bounds);
+    upload(vertexData.data(), static_cast<uint32_t>(vertices.size()), indices.data(),
+           static_cast<uint32_t>(indices.size()));
+}
+
+Mesh::Mesh(MeshData&& data, const VertexLayout& layout)
+    : Mesh(std::move(data.vertices), std::move(data.indices), layout)
+{
+}
+
+Mesh::Mesh(const std::string& filepath, const VertexLayout& layout) : m_Layout(layout)
 {
+    // Baked meshes are already encoded in the layout and go straight from the mapping into staging memory
+    BakedMesh baked;
+    if (MeshCache::load(filepath, layout, baked))
+    {
+        m_Bounds = baked.header->bounds;
+        m_Dequantization = layout.dequantization(m_Bounds);
+        upload(baked.vertexData, baked.header->vertexCount, baked.indices, baked.header->indexCount);
+        return;
+    }
+
+    MeshData data = Mesh::loadFromFile(filepath, GraphicsContext::get().threadPool());
+    m_Bounds = Bounds::fromVertices(data.vertices);
+    m_Dequantization = layout.dequantization(m_Bounds);
+    std::vector<uint8_t> vertexData = layout.encode(data.vertices, m_Bounds);
+    uint32_t vertexCount = static_cast<uint32_t>(data.vertices.size());
+    upload(vertexData.data(), vertexCount, data.indices.data(), static_cast<uint32_t>(data.indices.size()));
+
+    if (vertexCount > 0)
+        MeshCache::bake(filepath, layout, m_Bounds, vertexData.data(), vertexCount, data.indices);
 }
 
-Mesh::Mesh(const std::string& filepath) : Mesh(Mesh::loadFromFile(filepath).first, Mesh::loadFromFile(filepath).second)
+Mesh::~Mesh()
 {
+    GraphicsContext::get().geometryPool()->free(m_Geometry);
 }
 
-Mesh::~Mesh() {}
+void Mesh::upload(const void* vertexData, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+    VkDeviceSize vertexSize = static_cast<VkDeviceSize>(vertexCount) * m_Layout.stride();
+    m_SavedSize = vertexCount * sizeof(Vertex) - vertexSize;
+    if (m_SavedSize > 0)
+        V_LOG_INFO("Mesh with {} vertices uses {} bytes of vertex data, {} bytes saved by its layout.", vertexCount,
+                   vertexSize, m_SavedSize);
+
+    if (!GraphicsContext::get().geometryPool()->allocate(m_Layout, vertexData, vertexCount, indices, indexCount,
+                                                         m_Geometry))
+        V_LOG_ERROR("Unable to allocate geometry for mesh with {} vertices and {} indices.", vertexCount, indexCount);
+}
 
-std::pair<std::vector<Vertex>, std::vector<uint16_t>> Mesh::loadFromFile(const std::string& filepath)
+MeshData Mesh::loadFromFile(const std::string& filepath, ThreadPool* threadPool)
 {
+    auto start = std::chrono::steady_clock::now();
+
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(filepath, aiProcess_CalcTangentSpace | aiProcess_Triangulate |
                                                            aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
 
     if (!scene)
     {
-        // TODO: Do something
+        V_LOG_ERROR("Unable to load mesh {}: {}", filepath, importer.GetErrorString());
+        return MeshData();
     }
 
-    std::vector<Vertex> vertices;
-    std::vector<uint16_t> indices;
+    MeshData data = convertScene(scene, threadPool);
+
+    auto duration = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::steady_clock::now() - start);
+    V_LOG_DEBUG("Imported {} ({} meshes, {} vertices, {} indices) in {:.2f} ms on {} threads.", filepath,
+                scene->mNumMeshes, data.vertices.size(), data.indices.size(), duration.count(),
+                threadPool ? threadPool->threadCount() + 1 : 1);
+    return data;
+}
+
+MeshData Mesh::convertScene(const aiScene* scene, ThreadPool* threadPool)
+{
+    // Each sub-mesh writes to its own range, so sizes are counted first and the ranges filled in parallel
+    auto forEachMesh = [&](const std::function<void(uint32_t)>& task) {
+        if (threadPool && scene->mNumMeshes > 1)
+            threadPool->parallelFor(scene->mNumMeshes, task);
+        else
+            for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+                task(i);
+    };
+
+    MeshData data;
+    data.firstIndices.resize(scene->mNumMeshes + 1, 0);
+    forEachMesh([&](uint32_t i) { data.firstIndices[i + 1] = indexCount(scene->mMeshes[i]); });
+
+    std::vector<uint32_t> firstVertices(scene->mNumMeshes + 1, 0);
     for (uint32_t i = 0; i < scene->mNumMeshes; i++)
     {
-        aiMesh* mesh = scene->mMeshes[i];
-
-        for (uint32_t j = 0; j < mesh->mNumVertices; j++)
-        {
-            Vertex vertex;
-            vertex.position = glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
-            vertex.texCoord = glm::vec2(mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y);
-
-            vertices.push_back(vertex);
-        }
-
-        for (uint32_t j = 0; j < mesh->mNumFaces; j++)
-        {
-            for (uint32_t k = 0; k < mesh->mFaces[j].mNumIndices; k++)
-            {
-                indices.push_back(mesh->mFaces[j].mIndices[k]);
-            }
-        }
+        firstVertices[i + 1] = firstVertices[i] + scene->mMeshes[i]->mNumVertices;
+        data.firstIndices[i + 1] += data.firstIndices[i];
     }
+    data.vertices.resize(firstVertices.back());
+    data.indices.resize(data.firstIndices.back());
 
-    return std::pair<std::vector<Vertex>, std::vector<uint16_t>>(vertices, indices);
+    forEachMesh([&](uint32_t i) {
+        convertMesh(scene->mMeshes[i], firstVertices[i], data.vertices.data() + firstVertices[i],
+                    data.indices.data() + data.firstIndices[i]);
+    });
+    return data;
 }
 
 }; // namespace vrender
@@ -1,28 +1,61 @@
 #pragma once
 
+#include "core/memory/geometry_pool.hpp"
 #include "core/vulkan/buffer.hpp"
 #include "core/vulkan/pipeline.hpp"
 #include "core/vulkan/uniform.hpp"
 
 #include "ecs/component.hpp"
 #include "scene/scene.hpp"
+#include "utils/thread_pool.hpp"
+
+struct aiScene;
 
 namespace vrender
 {
 
+// Geometry of all sub-meshes of a file, indices already point at the merged vertices
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    // Indices of sub-mesh i are [firstIndices[i], firstIndices[i + 1])
+    std::vector<uint32_t> firstIndices;
+};
+
 class Mesh : public Component
 {
 public:
-    Mesh(std::vector<Vertex> vertices, std::vector<uint16_t> indices);
-    Mesh(const std::string& filepath);
+    Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, const VertexLayout& layout = VertexLayout());
+    Mesh(MeshData&& data, const VertexLayout& layout = VertexLayout());
+    // Loads the baked mesh of the file if it is up to date, otherwise imports and bakes it
+    Mesh(const std::string& filepath, const VertexLayout& layout = VertexLayout());
     ~Mesh();
 
-    inline VertexBuffer* vertexBuffer() { return &m_VertexBuffer; }
-
-    static std::pair<std::vector<Vertex>, std::vector<uint16_t>> loadFromFile(const std::string& filepath);
+    // Empty if the geometry could not be allocated
+    inline const GeometryHandle& geometry() const { return m_Geometry; }
+    // Vertex data is only kept on the device, bounds are what remains on the CPU
+    inline const Bounds& bounds() const { return m_Bounds; }
+    inline const VertexLayout& layout() const { return m_Layout; }
+    // Applied before the model matrix, maps quantized positions back to mesh space
+    inline const glm::mat4& dequantization() const { return m_Dequantization; }
+    // Device memory the layout saves compared to 32-bit float vertices
+    inline VkDeviceSize savedSize() const { return m_SavedSize; }
+
+    // Converts the sub-meshes on threadPool if given, empty if the file could not be read
+    static MeshData loadFromFile(const std::string& filepath, ThreadPool* threadPool = nullptr);
+    // Converts the meshes of an imported scene in the order of aiScene::mMeshes
+    static MeshData convertScene(const aiScene* scene, ThreadPool* threadPool = nullptr);
 
 private:
-    VertexBuffer m_VertexBuffer;
+    // Allocates the geometry from the pool, vertexData is encoded in m_Layout
+    void upload(const void* vertexData, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+    GeometryHandle m_Geometry = {};
+    Bounds m_Bounds;
+    VertexLayout m_Layout;
+    glm::mat4 m_Dequantization;
+    VkDeviceSize m_SavedSize = 0;
 
     uint32_t m_CurrentImage = 0;
 };
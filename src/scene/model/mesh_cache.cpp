@@ -0,0 +1,178 @@
+#include "mesh_cache.hpp"
+
+#include "utils/log.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+namespace vrender
+{
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool sourceState(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(sourcePath, error);
+    if (error)
+        return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+    return !error;
+}
+
+// FNV-1a over the whole file
+static bool sourceHash(const std::string& sourcePath, uint64_t& hash)
+{
+    MappedFile file;
+    if (!file.open(sourcePath))
+        return false;
+
+    hash = 0xcbf29ce484222325ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(file.data());
+    for (size_t i = 0; i < file.size(); i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return true;
+}
+
+// Rewrites the source state in the header of a baked mesh that is not mapped
+static bool refreshSourceState(const std::string& path, uint64_t size, int64_t time)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offsetof(BakedMeshHeader, sourceSize));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.seekp(offsetof(BakedMeshHeader, sourceTime));
+    file.write(reinterpret_cast<const char*>(&time), sizeof(time));
+    return file.good();
+}
+
+// With refreshSource a baked mesh whose source only changed its size or time is given the new state, so later
+// loads do not hash the source again
+static bool loadBaked(const std::string& sourcePath, const VertexLayout& layout, BakedMesh& mesh, bool refreshSource)
+{
+    std::string path = MeshCache::bakedPath(sourcePath, layout);
+    if (!mesh.file.open(path))
+        return false;
+
+    if (mesh.file.size() < sizeof(BakedMeshHeader))
+    {
+        V_LOG_WARNING("Ignoring invalid baked mesh {}.", path);
+        mesh.file.close();
+        return false;
+    }
+
+    const BakedMeshHeader* header = static_cast<const BakedMeshHeader*>(mesh.file.data());
+    uint64_t vertexSize = static_cast<uint64_t>(header->vertexCount) * header->stride;
+    uint64_t indexSize = static_cast<uint64_t>(header->indexCount) * sizeof(uint32_t);
+    if (header->magic != MeshCache::MAGIC || header->version != MeshCache::VERSION ||
+        header->layoutKey != layout.key() || header->stride != layout.stride() ||
+        header->vertexOffset % alignof(float) != 0 || header->indexOffset % alignof(uint32_t) != 0 ||
+        header->vertexOffset > mesh.file.size() || vertexSize > mesh.file.size() - header->vertexOffset ||
+        header->indexOffset > mesh.file.size() || indexSize > mesh.file.size() - header->indexOffset)
+    {
+        V_LOG_WARNING("Ignoring invalid baked mesh {}.", path);
+        mesh.file.close();
+        return false;
+    }
+
+    // Baked meshes may ship without their source
+    uint64_t size;
+    int64_t time;
+    if (sourceState(sourcePath, size, time) && (size != header->sourceSize || time != header->sourceTime))
+    {
+        uint64_t hash;
+        if (!sourceHash(sourcePath, hash) || hash != header->sourceHash)
+        {
+            V_LOG_INFO("Baked mesh {} is out of date.", path);
+            mesh.file.close();
+            return false;
+        }
+
+        // The header is mapped read only, the file is closed while it is written
+        if (refreshSource)
+        {
+            mesh.file.close();
+            if (!refreshSourceState(path, size, time))
+                V_LOG_WARNING("Could not update the source state of baked mesh {}.", path);
+            return loadBaked(sourcePath, layout, mesh, false);
+        }
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(mesh.file.data());
+    mesh.header = header;
+    mesh.vertexData = data + header->vertexOffset;
+    mesh.indices = reinterpret_cast<const uint32_t*>(data + header->indexOffset);
+    return true;
+}
+
+std::string MeshCache::bakedPath(const std::string& sourcePath, const VertexLayout& layout)
+{
+    return sourcePath + "." + std::to_string(layout.key()) + ".vmesh";
+}
+
+bool MeshCache::load(const std::string& sourcePath, const VertexLayout& layout, BakedMesh& mesh)
+{
+    return loadBaked(sourcePath, layout, mesh, true);
+}
+
+bool MeshCache::bake(const std::string& sourcePath, const VertexLayout& layout, const Bounds& bounds,
+                     const void* vertexData, uint32_t vertexCount, const std::vector<uint32_t>& indices)
+{
+    BakedMeshHeader header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.layoutKey = layout.key();
+    header.stride = layout.stride();
+    header.vertexCount = vertexCount;
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.vertexOffset = alignUp(sizeof(BakedMeshHeader), 16);
+    header.indexOffset = alignUp(header.vertexOffset + static_cast<uint64_t>(vertexCount) * header.stride, 16);
+    header.bounds = bounds;
+    if (!sourceState(sourcePath, header.sourceSize, header.sourceTime) || !sourceHash(sourcePath, header.sourceHash))
+        return false;
+
+    // Written to a temporary file first, so a failed bake never leaves a truncated mesh behind
+    std::string path = bakedPath(sourcePath, layout);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            V_LOG_WARNING("Could not write baked mesh {}.", path);
+            return false;
+        }
+
+        const char padding[16] = {};
+        std::streamsize vertexSize = static_cast<std::streamsize>(vertexCount) * header.stride;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding, header.vertexOffset - sizeof(header));
+        file.write(static_cast<const char*>(vertexData), vertexSize);
+        file.write(padding, header.indexOffset - header.vertexOffset - vertexSize);
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+        if (!file.good())
+        {
+            V_LOG_WARNING("Could not write baked mesh {}.", path);
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        V_LOG_WARNING("Could not replace baked mesh {}: {}", path, error.message());
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    V_LOG_DEBUG("Baked {} vertices and {} indices of {} to {}.", vertexCount, indices.size(), sourcePath, path);
+    return true;
+}
+
+}; // namespace vrender
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core/vulkan/buffer.hpp"
+#include "utils/mapped_file.hpp"
+
+#include <string>
+#include <vector>
+
+namespace vrender
+{
+
+// Start of a baked mesh file, followed by the vertices encoded in the layout and 32-bit indices
+struct BakedMeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layoutKey;
+    uint32_t stride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset; // Bytes from the start of the file
+    uint64_t indexOffset;
+    // State of the source file when it was baked
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    Bounds bounds;
+};
+
+// Baked mesh mapped into memory, the data pointers stay valid as long as the mesh
+struct BakedMesh
+{
+    MappedFile file;
+    const BakedMeshHeader* header = nullptr;
+    const void* vertexData = nullptr;
+    const uint32_t* indices = nullptr;
+};
+
+// Meshes are baked next to their source as <source>.<layout>.vmesh in the layout they are uploaded in, so loading
+// them skips the importer. A baked mesh is rebuilt when the size and modification time of its source changed and
+// the content hash does not match either, if the hash matches the new size and time are written to its header. Only
+// the source file itself is tracked, not files it references
+class MeshCache
+{
+public:
+    static std::string bakedPath(const std::string& sourcePath, const VertexLayout& layout);
+
+    // Returns false if there is no baked mesh for the layout or it is out of date
+    static bool load(const std::string& sourcePath, const VertexLayout& layout, BakedMesh& mesh);
+    // vertexData holds vertexCount vertices encoded in layout
+    static bool bake(const std::string& sourcePath, const VertexLayout& layout, const Bounds& bounds,
+                     const void* vertexData, uint32_t vertexCount, const std::vector<uint32_t>& indices);
+
+    static constexpr uint32_t MAGIC = 0x48534d56; // "VMSH"
+    static constexpr uint32_t VERSION = 1;
+};
+
+}; // namespace vrender
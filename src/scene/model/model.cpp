@@ -1,17 +1,132 @@
 #include "model.hpp"
 
+#include "core/graphics_context.hpp"
+#include "utils/log.hpp"
+
+#include "assimp/Importer.hpp"
+#include <assimp/config.h>
+#include <assimp/material.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <chrono>
+#include <filesystem>
+
 namespace vrender
 {
 
-// Model::Model(const std::vector<Mesh>& meshes) : m_Meshes(meshes) {}
+static Material convertMaterial(const aiMaterial* material, const std::filesystem::path& directory)
+{
+    Material converted;
+    converted.name = material->GetName().C_Str();
+
+    aiColor4D color;
+    if (material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS)
+        converted.baseColor = glm::vec4(color.r, color.g, color.b, color.a);
+
+    // glTF base color textures are imported as diffuse textures
+    aiString path;
+    if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) != AI_SUCCESS)
+        return converted;
 
-Model::~Model() {}
+    if (path.C_Str()[0] == '*')
+        V_LOG_WARNING("Embedded texture {} of material {} is not supported.", path.C_Str(), converted.name);
+    else
+        converted.baseColorTexture =
+            GraphicsContext::get().assetManager()->loadTexture((directory / path.C_Str()).generic_string());
+    return converted;
+}
 
-void Model::draw(const VkCommandBuffer& commandBuffer)
+Model::Model(const std::string& filepath, const VertexLayout& layout)
 {
-    for (auto& mesh : m_Meshes)
+    auto start = std::chrono::steady_clock::now();
+
+    // Points and lines cannot be drawn with the triangle pipelines
+    Assimp::Importer importer;
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    const aiScene* scene =
+        importer.ReadFile(filepath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
+
+    if (!scene || !scene->mRootNode)
+    {
+        V_LOG_ERROR("Unable to load model {}: {}", filepath, importer.GetErrorString());
+        return;
+    }
+
+    MeshData data = Mesh::convertScene(scene, GraphicsContext::get().threadPool());
+    m_SubMeshes.reserve(scene->mNumMeshes);
+    for (uint32_t i = 0; i < scene->mNumMeshes; i++)
     {
-        // mesh.draw(commandBuffer);
+        m_SubMeshes.push_back({data.firstIndices[i], data.firstIndices[i + 1] - data.firstIndices[i],
+                               scene->mMeshes[i]->mMaterialIndex});
     }
+    if (!data.indices.empty())
+        m_Mesh = std::make_shared<Mesh>(std::move(data), layout);
+
+    std::filesystem::path directory = std::filesystem::path(filepath).parent_path();
+    m_Materials->reserve(scene->mNumMaterials);
+    for (uint32_t i = 0; i < scene->mNumMaterials; i++)
+        m_Materials->push_back(convertMaterial(scene->mMaterials[i], directory));
+
+    addNode(scene->mRootNode, UINT32_MAX);
+
+    auto duration = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::steady_clock::now() - start);
+    V_LOG_DEBUG("Imported model {} ({} nodes, {} primitives, {} materials) in {:.2f} ms.", filepath, m_Nodes.size(),
+                m_SubMeshes.size(), m_Materials->size(), duration.count());
 }
+
+Entity* Model::instantiate(Scene* scene) const
+{
+    if (!loaded())
+        return nullptr;
+
+    std::vector<Entity*> entities;
+    entities.reserve(m_Nodes.size());
+    for (const Node& node : m_Nodes)
+    {
+        Entity* entity = scene->createEntity();
+        entity->addComponent<Transform>();
+
+        Transform* transform = entity->getComponent<Transform>();
+        transform->position = node.position;
+        transform->rotation = node.rotation;
+        transform->scale = node.scale;
+        if (node.parent != UINT32_MAX)
+            transform->parent = entities[node.parent]->getComponent<Transform>();
+
+        if (m_Mesh && !node.subMeshes.empty())
+        {
+            entity->addComponent<ModelNode>();
+            ModelNode* modelNode = entity->getComponent<ModelNode>();
+            modelNode->mesh = m_Mesh;
+            modelNode->materials = m_Materials;
+            for (uint32_t subMesh : node.subMeshes)
+                modelNode->subMeshes.push_back(m_SubMeshes[subMesh]);
+        }
+        entities.push_back(entity);
+    }
+    return entities.front();
+}
+
+void Model::addNode(const aiNode* node, uint32_t parent)
+{
+    aiVector3D scale, position;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scale, rotation, position);
+
+    Node converted;
+    converted.name = node->mName.C_Str();
+    converted.position = glm::vec3(position.x, position.y, position.z);
+    converted.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+    converted.scale = glm::vec3(scale.x, scale.y, scale.z);
+    converted.parent = parent;
+    converted.subMeshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+    uint32_t index = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes.push_back(std::move(converted));
+    for (uint32_t i = 0; i < node->mNumChildren; i++)
+        addNode(node->mChildren[i], index);
+}
+
 }; // namespace vrender
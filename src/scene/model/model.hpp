@@ -1,20 +1,73 @@
 #pragma once
 
 #include "mesh.hpp"
+#include "scene/asset_manager.hpp"
 
+#include <memory>
+#include <string>
 #include <vector>
 
+struct aiNode;
+
 namespace vrender
 {
+
+// Range of one primitive in the geometry of its model
+struct SubMesh
+{
+    uint32_t firstIndex; // Relative to the first index of the model's geometry
+    uint32_t indexCount;
+    uint32_t material; // Index into Model::materials()
+};
+
+struct Material
+{
+    std::string name;
+    glm::vec4 baseColor = glm::vec4(1.0f);
+    AssetHandle<Texture> baseColorTexture; // Null if the material has none
+};
+
+// Primitives of a model drawn at the transform of a node entity
+struct ModelNode : public Component
+{
+    std::shared_ptr<Mesh> mesh; // Geometry of the whole model
+    std::vector<SubMesh> subMeshes;
+    std::shared_ptr<const std::vector<Material>> materials; // Of the whole model
+};
+
+// Scene file imported as a hierarchy of nodes. The file and its buffers are parsed once and all primitives share one
+// geometry allocation, they only differ in their index ranges. Materials load their textures in the background. The
+// constructor imports the whole file, load models through AssetManager::loadModel to keep it off the render thread
 class Model
 {
 public:
-    // Model(const std::vector<Mesh>& meshes);
-    ~Model();
+    Model(const std::string& filepath, const VertexLayout& layout = VertexLayout());
 
-    void draw(const VkCommandBuffer& commandBuffer);
+    // Creates one entity per node with a Transform relative to its parent, nodes with primitives also get a
+    // ModelNode. Returns the root entity, null if the file could not be loaded
+    Entity* instantiate(Scene* scene) const;
+
+    inline bool loaded() const { return !m_Nodes.empty(); }
+    inline const std::shared_ptr<Mesh>& mesh() const { return m_Mesh; }
+    inline const std::vector<SubMesh>& subMeshes() const { return m_SubMeshes; }
+    inline const std::vector<Material>& materials() const { return *m_Materials; }
 
 private:
-    std::vector<Mesh> m_Meshes;
+    struct Node
+    {
+        std::string name;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        uint32_t parent; // Index into m_Nodes, UINT32_MAX for the root
+        std::vector<uint32_t> subMeshes;
+    };
+
+    void addNode(const aiNode* node, uint32_t parent);
+
+    std::shared_ptr<Mesh> m_Mesh;
+    std::vector<SubMesh> m_SubMeshes; // In the order of the imported meshes
+    std::shared_ptr<std::vector<Material>> m_Materials = std::make_shared<std::vector<Material>>(); // Shared by nodes
+    std::vector<Node> m_Nodes; // Parents come before their children
 };
 }; // namespace vrender
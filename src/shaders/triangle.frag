@@ -7,10 +7,17 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 0, binding = 2) uniform sampler2D texSampler;
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
+
+layout(push_constant) uniform Push
+{
+    mat4 model;
+    vec4 baseColor;
+}
+push;
 
 void main()
 {
-    outColor = texture(texSampler, fragTexCoord);
+    outColor = texture(texSampler, fragTexCoord) * push.baseColor;
     // outColor = vec4(0.0, 0.0, gl_FragCoord.z / 5, 1.0);
 }
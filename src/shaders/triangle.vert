@@ -10,6 +10,7 @@ ubo;
 layout(push_constant) uniform Push
 {
     mat4 model;
+    vec4 baseColor;
 }
 push;
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "utils/noncopyable.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace vrender
+{
+
+// Read only view of a whole file mapped into memory
+class MappedFile : private NonCopyable
+{
+public:
+    MappedFile() {}
+    ~MappedFile();
+
+    // Returns false if the file cannot be opened or is empty
+    bool open(const std::string& path);
+    void close();
+
+    inline const void* data() const { return m_Data; }
+    inline size_t size() const { return m_Size; }
+
+private:
+    const void* m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    void* m_File = nullptr;
+    void* m_Mapping = nullptr;
+#endif
+};
+
+}; // namespace vrender
@@ -0,0 +1,103 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace vrender
+{
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_Threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+
+    for (std::thread& thread : m_Threads)
+        thread.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packagedTask(std::move(task));
+    std::future<void> future = packagedTask.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(packagedTask));
+    }
+    m_Condition.notify_one();
+    return future;
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+{
+    if (count == 0)
+        return;
+
+    // Helpers may only start after the loop is done, they must not touch the caller's stack
+    struct Loop
+    {
+        std::function<void(uint32_t)> task;
+        uint32_t count;
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+    loop->task = task;
+    loop->count = count;
+
+    auto run = [](Loop& loop) {
+        for (uint32_t i = loop.next++; i < loop.count; i = loop.next++)
+        {
+            loop.task(i);
+            if (++loop.done == loop.count)
+            {
+                std::lock_guard<std::mutex> lock(loop.mutex);
+                loop.finished.notify_all();
+            }
+        }
+    };
+
+    uint32_t helperCount = std::min(threadCount(), count - 1);
+    for (uint32_t i = 0; i < helperCount; i++)
+        submit([loop, run]() { run(*loop); });
+
+    // The caller works too, so loops nested in tasks cannot run out of workers
+    run(*loop);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&loop]() { return loop->done == loop->count; });
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty())
+                return;
+
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}; // namespace vrender
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "utils/noncopyable.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vrender
+{
+
+// Fixed set of worker threads running tasks in submission order
+class ThreadPool : private NonCopyable
+{
+public:
+    // Zero uses one thread per hardware thread
+    ThreadPool(uint32_t threadCount = 0);
+    // Runs the tasks already submitted before joining the workers
+    ~ThreadPool();
+
+    std::future<void> submit(std::function<void()> task);
+
+    // Calls task(i) for every i in [0, count) on the workers and the calling thread, returns once all calls have
+    // returned. Safe to call from a task
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+    inline uint32_t threadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+    void work();
+
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_Mutex; // Guards everything below
+    std::condition_variable m_Condition;
+    std::deque<std::packaged_task<void()>> m_Tasks;
+    bool m_Stopping = false;
+};
+
+}; // namespace vrender
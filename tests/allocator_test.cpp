@@ -0,0 +1,485 @@
+#include "core/memory/buddy_allocation.hpp"
+#include "core/memory/memory_allocator.hpp"
+#include "core/memory/staging_ring.hpp"
+#include "core/memory/tlsf_allocation.hpp"
+#include "core/memory/transient_image_pool.hpp"
+#include "mock_device_memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <cctype>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vrender;
+
+static int s_Failures = 0;
+
+#define CHECK(condition)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                                  \
+            s_Failures++;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+using AllocationFactory = std::function<std::unique_ptr<MemoryAllocation>(VkDeviceSize size)>;
+
+static constexpr VkDeviceSize ALLOCATION_SIZE = 1024 * 1024;
+
+static void checkEmpty(const MemoryAllocation& allocation)
+{
+    CHECK(allocation.allocatedSize() == 0);
+    CHECK(allocation.wastedSize() == 0);
+    CHECK(allocation.freeRangeCount() == 1);
+    CHECK(allocation.largestFreeRange() == allocation.size());
+}
+
+// Fills the allocation, then frees neighbouring blocks and expects them to merge
+static void testCoalescing(const AllocationFactory& create)
+{
+    std::unique_ptr<MemoryAllocation> allocation = create(ALLOCATION_SIZE);
+    CHECK(allocation->valid());
+
+    const VkDeviceSize blockSize = 4096;
+    std::vector<MemoryBlock> blocks(ALLOCATION_SIZE / blockSize);
+    for (MemoryBlock& block : blocks)
+        CHECK(allocation->allocateBlock(blockSize, 256, block));
+    CHECK(allocation->largestFreeRange() == 0);
+
+    MemoryBlock overflow;
+    CHECK(!allocation->allocateBlock(blockSize, 256, overflow));
+
+    std::sort(blocks.begin(), blocks.end(),
+              [](const MemoryBlock& a, const MemoryBlock& b) { return a.offset < b.offset; });
+    CHECK(blocks.front().offset == 0);
+
+    CHECK(allocation->freeBlock(blocks[0]));
+    CHECK(allocation->largestFreeRange() == blockSize);
+    CHECK(allocation->freeBlock(blocks[1]));
+    CHECK(allocation->largestFreeRange() == 2 * blockSize);
+    CHECK(allocation->freeRangeCount() == 1);
+
+    // Not adjacent to the first two
+    CHECK(allocation->freeBlock(blocks[4]));
+    CHECK(allocation->freeRangeCount() == 2);
+    CHECK(allocation->largestFreeRange() == 2 * blockSize);
+
+    // A double free is rejected and changes nothing
+    CHECK(!allocation->freeBlock(blocks[4]));
+    CHECK(allocation->allocatedSize() == ALLOCATION_SIZE - 3 * blockSize);
+
+    MemoryBlock merged;
+    CHECK(allocation->allocateBlock(2 * blockSize, 256, merged));
+    CHECK(merged.offset == 0);
+    CHECK(allocation->freeBlock(merged));
+
+    for (size_t i = 2; i < blocks.size(); i++)
+    {
+        if (i != 4)
+            CHECK(allocation->freeBlock(blocks[i]));
+    }
+    checkEmpty(*allocation);
+}
+
+// Padding in front of an aligned block belongs to the block and is returned with it
+static void testAlignment(const AllocationFactory& create)
+{
+    std::unique_ptr<MemoryAllocation> allocation = create(ALLOCATION_SIZE);
+
+    MemoryBlock small, aligned;
+    CHECK(allocation->allocateBlock(100, 1, small));
+    CHECK(allocation->allocateBlock(100, 4096, aligned));
+    CHECK(aligned.offset % 4096 == 0);
+    CHECK(aligned.offset >= small.offset + small.size || aligned.offset + aligned.size <= small.offset);
+    CHECK(allocation->allocatedSize() >= 200);
+
+    CHECK(allocation->freeBlock(aligned));
+    CHECK(allocation->freeBlock(small));
+    checkEmpty(*allocation);
+}
+
+// Random sizes and alignments, blocks must never overlap and the allocation must be whole again afterwards
+static void testChurn(const AllocationFactory& create)
+{
+    std::unique_ptr<MemoryAllocation> allocation = create(ALLOCATION_SIZE);
+
+    std::mt19937 random(7);
+    std::map<VkDeviceSize, MemoryBlock> live; // Keyed by offset
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        if (!live.empty() && std::bernoulli_distribution(0.45)(random))
+        {
+            auto it = std::next(live.begin(), std::uniform_int_distribution<size_t>(0, live.size() - 1)(random));
+            CHECK(allocation->freeBlock(it->second));
+            live.erase(it);
+            continue;
+        }
+
+        VkDeviceSize size = std::uniform_int_distribution<VkDeviceSize>(1, 16 * 1024)(random);
+        VkDeviceSize alignment = VkDeviceSize(1) << std::uniform_int_distribution<uint32_t>(0, 10)(random);
+        MemoryBlock block;
+        if (!allocation->allocateBlock(size, alignment, block))
+            continue;
+
+        CHECK(block.size >= size);
+        CHECK(block.offset % alignment == 0);
+        CHECK(block.offset + block.size <= allocation->size());
+        auto next = live.lower_bound(block.offset);
+        if (next != live.end())
+            CHECK(block.offset + block.size <= next->first);
+        if (next != live.begin())
+            CHECK(std::prev(next)->second.offset + std::prev(next)->second.size <= block.offset);
+        live[block.offset] = block;
+    }
+
+    for (const auto& [offset, block] : live)
+        CHECK(allocation->freeBlock(block));
+    checkEmpty(*allocation);
+}
+
+// Device memory is created on demand and returned once it stayed empty for the release delay
+static void testAllocator()
+{
+    {
+        DeviceMemoryAllocator allocator(VK_NULL_HANDLE, mock::memoryProperties(), 1, mock::deviceMemoryFunctions());
+        allocator.setReleaseDelay(0);
+
+        std::vector<MemoryBlock> blocks(64);
+        for (MemoryBlock& block : blocks)
+            CHECK(allocator.allocate(256 * 1024, 256, 0, block));
+        CHECK(mock::deviceMemoryCount > 1);
+        CHECK(allocator.stats(0).blockCount == blocks.size());
+
+        for (const MemoryBlock& block : blocks)
+            allocator.free(block);
+        allocator.update();
+        CHECK(allocator.stats(0).blockCount == 0);
+        CHECK(allocator.stats(0).allocatedSize == 0);
+        CHECK(mock::deviceMemoryCount == 0);
+    }
+    CHECK(mock::deviceMemoryCount == 0);
+}
+
+// Minimal JSON syntax check, advances json past one value
+static bool parseJsonValue(const char*& json)
+{
+    auto skipSpace = [&json]() {
+        while (std::isspace(static_cast<unsigned char>(*json)))
+            json++;
+    };
+    auto parseString = [&json]() {
+        if (*json++ != '"')
+            return false;
+        while (*json && *json != '"')
+        {
+            if (*json++ == '\\' && !*json++)
+                return false;
+        }
+        return *json++ == '"';
+    };
+
+    skipSpace();
+    if (*json == '{' || *json == '[')
+    {
+        char close = *json == '{' ? '}' : ']';
+        bool object = close == '}';
+        json++;
+        skipSpace();
+        if (*json == close)
+        {
+            json++;
+            return true;
+        }
+        for (;;)
+        {
+            skipSpace();
+            if (object)
+            {
+                if (!parseString())
+                    return false;
+                skipSpace();
+                if (*json++ != ':')
+                    return false;
+            }
+            if (!parseJsonValue(json))
+                return false;
+            skipSpace();
+            if (*json == close)
+            {
+                json++;
+                return true;
+            }
+            if (*json++ != ',')
+                return false;
+        }
+    }
+    if (*json == '"')
+        return parseString();
+    for (const char* literal : {"true", "false", "null"})
+    {
+        if (std::strncmp(json, literal, std::strlen(literal)) == 0)
+        {
+            json += std::strlen(literal);
+            return true;
+        }
+    }
+
+    char* end;
+    std::strtod(json, &end);
+    if (end == json)
+        return false;
+    json = end;
+    return true;
+}
+
+static bool validJson(const std::string& json)
+{
+    const char* end = json.c_str();
+    if (!parseJsonValue(end))
+        return false;
+    while (std::isspace(static_cast<unsigned char>(*end)))
+        end++;
+    return *end == '\0';
+}
+
+static size_t countOccurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for (size_t i = text.find(pattern); i != std::string::npos; i = text.find(pattern, i + pattern.size()))
+        count++;
+    return count;
+}
+
+// Stats, the JSON dump and leaked blocks after a known sequence of allocations
+static void testStats()
+{
+    DeviceMemoryAllocator allocator(VK_NULL_HANDLE, mock::memoryProperties(), 1, mock::deviceMemoryFunctions());
+    allocator.setThreadCacheEnabled(false);
+
+    const VkDeviceSize blockSize = 64 * 1024;
+    std::vector<MemoryBlock> blocks(4);
+    for (MemoryBlock& block : blocks)
+        CHECK(allocator.allocate(blockSize, 256, 0, block));
+
+    MemoryTypeStats stats = allocator.stats(0);
+    CHECK(stats.allocationCount == 1);
+    CHECK(stats.reservedSize >= blocks.size() * blockSize);
+    CHECK(stats.allocatedSize == blocks.size() * blockSize);
+    CHECK(stats.wastedSize == 0);
+    CHECK(stats.largestFreeRange == stats.reservedSize - blocks.size() * blockSize);
+    CHECK(stats.fragmentation == 0.0f);
+    CHECK(stats.allocateCount == blocks.size());
+    CHECK(stats.freeCount == 0);
+    CHECK(stats.blockCount == blocks.size());
+    CHECK(allocator.stats(1).reservedSize == 0);
+
+    // A hole smaller than the free range at the end
+    allocator.free(blocks[1]);
+    stats = allocator.stats(0);
+    CHECK(stats.allocatedSize == 3 * blockSize);
+    CHECK(stats.largestFreeRange == stats.reservedSize - blocks.size() * blockSize);
+    CHECK(stats.fragmentation > 0.0f);
+    CHECK(stats.freeCount == 1);
+    CHECK(stats.blockCount == 3);
+
+    HeapStats heap = allocator.heapStats(0);
+    CHECK(heap.types.reservedSize == stats.reservedSize);
+    CHECK(heap.types.allocatedSize == stats.allocatedSize);
+    CHECK(heap.types.blockCount == stats.blockCount);
+    CHECK(heap.usage == stats.reservedSize);
+    CHECK(allocator.heapStats(1).usage == 0);
+
+    std::string json = allocator.dumpJson();
+    CHECK(validJson(json));
+    CHECK(countOccurrences(json, "\"free\":false") == stats.blockCount);
+
+    allocator.free(blocks[0]);
+    allocator.free(blocks[2]);
+    std::vector<MemoryBlock> leaked = allocator.leakedBlocks();
+    CHECK(leaked.size() == 1);
+    CHECK(!leaked.empty() && leaked[0].offset == blocks[3].offset && leaked[0].size == blockSize);
+
+    allocator.free(blocks[3]);
+    CHECK(allocator.leakedBlocks().empty());
+    CHECK(allocator.stats(0).freeCount == blocks.size());
+}
+
+// Ranges are taken at the head, wrap to the start when the end is too small and are returned oldest first
+static void testStagingRing()
+{
+    StagingRing ring(1024, 16);
+    VkDeviceSize offset, reserved;
+
+    CHECK(ring.allocate(10, offset, reserved));
+    CHECK(offset == 0 && reserved == 16);
+    CHECK(ring.allocate(400, offset, reserved));
+    CHECK(offset == 16 && reserved == 400);
+    CHECK(ring.allocate(512, offset, reserved));
+    CHECK(offset == 416 && ring.head() == 928);
+
+    // Does not fit before the end and nothing was returned at the start yet
+    CHECK(!ring.allocate(200, offset, reserved));
+    ring.release(16);
+    CHECK(!ring.allocate(200, offset, reserved));
+    ring.release(400);
+    CHECK(ring.tail() == 416);
+
+    // Wraps, the bytes skipped at the end belong to the reservation
+    CHECK(ring.allocate(200, offset, reserved));
+    CHECK(offset == 0 && reserved == 1024 - 928 + 208);
+    CHECK(ring.allocate(208, offset, reserved));
+    CHECK(offset == 208 && ring.head() == ring.tail());
+    CHECK(ring.usedSize() == ring.size());
+    CHECK(!ring.allocate(16, offset, reserved));
+
+    ring.release(512);
+    ring.release(1024 - 928 + 208);
+    CHECK(ring.tail() == 208);
+    ring.release(208);
+    CHECK(ring.usedSize() == 0);
+
+    // An empty ring starts over at 0
+    CHECK(ring.allocate(112, offset, reserved));
+    CHECK(offset == 0);
+
+    // A batch that staged nothing retires after the ring was reset, the tail stays with the live reservation
+    ring.release(112);
+    CHECK(ring.allocate(208, offset, reserved));
+    CHECK(offset == 0);
+    ring.release(0);
+    CHECK(ring.tail() == 0);
+    CHECK(ring.allocate(1024 - 208, offset, reserved));
+    CHECK(offset == 208);
+    CHECK(!ring.allocate(16, offset, reserved));
+    ring.release(208);
+    CHECK(ring.tail() == 208);
+    CHECK(ring.allocate(208, offset, reserved));
+    CHECK(offset == 0);
+    CHECK(!ring.allocate(16, offset, reserved));
+}
+
+// Places the ranges and checks that ranges used at the same time do not intersect, returns the placed size
+static VkDeviceSize placeTransient(std::vector<TransientRange>& ranges)
+{
+    std::vector<TransientRange*> pointers;
+    VkDeviceSize sizeSum = 0;
+    for (TransientRange& range : ranges)
+    {
+        pointers.push_back(&range);
+        sizeSum += range.size;
+    }
+
+    VkDeviceSize requiredSize;
+    VkDeviceSize size = TransientImagePool::place(pointers, requiredSize);
+    CHECK(size <= requiredSize);
+    CHECK(requiredSize >= sizeSum);
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        const TransientRange& a = ranges[i];
+        CHECK(a.offset % a.alignment == 0);
+        CHECK(a.offset + a.size <= size);
+        for (size_t j = i + 1; j < ranges.size(); j++)
+        {
+            const TransientRange& b = ranges[j];
+            bool live = a.firstUse <= b.lastUse && b.firstUse <= a.lastUse;
+            CHECK(!live || a.offset + a.size <= b.offset || b.offset + b.size <= a.offset);
+        }
+    }
+    return size;
+}
+
+// Images used in passes that do not overlap alias the same memory
+static void testTransientPlacement()
+{
+    std::vector<TransientRange> disjoint = {
+        {4096, 256, 0, 1, 0},
+        {2048, 256, 2, 3, 0},
+        {4096, 256, 4, 4, 0},
+    };
+    CHECK(placeTransient(disjoint) == 4096);
+    for (const TransientRange& range : disjoint)
+        CHECK(range.offset == 0);
+
+    std::vector<TransientRange> overlapping = {
+        {4096, 256, 0, 2, 0},
+        {2048, 256, 1, 3, 0},
+        {1024, 256, 3, 4, 0},
+    };
+    // The last one only overlaps the second and fits below it
+    CHECK(placeTransient(overlapping) == 4096 + 2048);
+    CHECK(overlapping[2].offset == 0);
+
+    std::vector<TransientRange> aligned = {
+        {1000, 1, 0, 1, 0},
+        {512, 4096, 1, 2, 0},
+        {100, 64, 0, 2, 0},
+    };
+    placeTransient(aligned);
+    CHECK(aligned[1].offset == 4096);
+
+    std::mt19937 random(3);
+    for (int round = 0; round < 100; round++)
+    {
+        std::vector<TransientRange> ranges(1 + random() % 16);
+        for (TransientRange& range : ranges)
+        {
+            uint32_t firstUse = random() % 8;
+            range = {1 + random() % 65536, VkDeviceSize(1) << (random() % 13), firstUse,
+                     firstUse + static_cast<uint32_t>(random() % 4), 0};
+        }
+        placeTransient(ranges);
+    }
+}
+
+int main()
+{
+    std::vector<std::pair<const char*, AllocationFactory>> backends = {
+        {"free list",
+         [](VkDeviceSize size) {
+             return std::make_unique<FreeListAllocation>(VK_NULL_HANDLE, mock::deviceMemoryFunctions(), size, 0);
+         }},
+        {"tlsf",
+         [](VkDeviceSize size) {
+             return std::make_unique<TlsfAllocation>(VK_NULL_HANDLE, mock::deviceMemoryFunctions(), size, 0);
+         }},
+        {"buddy",
+         [](VkDeviceSize size) {
+             return std::make_unique<BuddyAllocation>(VK_NULL_HANDLE, mock::deviceMemoryFunctions(), size, 0);
+         }},
+    };
+
+    for (const auto& [name, create] : backends)
+    {
+        int failures = s_Failures;
+        testCoalescing(create);
+        testAlignment(create);
+        testChurn(create);
+        std::printf("%-9s %s\n", name, s_Failures == failures ? "passed" : "FAILED");
+    }
+
+    int failures = s_Failures;
+    testAllocator();
+    std::printf("%-9s %s\n", "allocator", s_Failures == failures ? "passed" : "FAILED");
+
+    failures = s_Failures;
+    testStats();
+    std::printf("%-9s %s\n", "stats", s_Failures == failures ? "passed" : "FAILED");
+
+    failures = s_Failures;
+    testStagingRing();
+    std::printf("%-9s %s\n", "ring", s_Failures == failures ? "passed" : "FAILED");
+
+    failures = s_Failures;
+    testTransientPlacement();
+    std::printf("%-9s %s\n", "transient", s_Failures == failures ? "passed" : "FAILED");
+
+    return s_Failures == 0 ? 0 : 1;
+}